@@ -0,0 +1,480 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "ByteProfile.hpp"
+#include "RelocationMap.hpp"
+#include "Resolver.hpp"
+#include "Signature.hpp"
+#include "SignatureEngine.hpp"
+#include "SignatureScanner.hpp"
+
+namespace {
+typedef unsigned char byte;
+}
+
+/* Module region source
+ *
+ * The searchable regions of a module in the current process (see
+ * <SignatureScanner::GetSearchableRegions>), clamped to a range, searched
+ * like <SignatureScanner::FindSignature> does: anchors are selected by the
+ * module's byte profile if it has been computed, relocated bytes can be
+ * ignored, and matches are resolved within the module.
+ */
+class ModuleSource {
+public:
+    /* Construct the source of a module's regions
+     *
+     * The scanner is copied, so the source may outlive it. An <Exception> is
+     * thrown for <SignatureScanner::FunctionStarts>, which only the scanner
+     * itself supports.
+     *
+     * @scanner The scanner of the module.
+     *
+     * @offset The start offset of the range, relative to the module base.
+     *
+     * @length The maximum distance of the range.
+     *
+     * @flags A combination of <SignatureScanner::SearchFlags>.
+     */
+    explicit ModuleSource(
+        const SignatureScanner& scanner,
+        size_t offset = 0,
+        size_t length = SignatureScanner::npos,
+        uint flags = 0);
+
+    /* Iterate over the regions, in ascending order
+     *
+     * @callback A callable with the signature 'bool(const byte*, const byte*)',
+     *           receiving the bounds of each region. The iteration stops
+     *           when it returns false.
+     */
+    template<typename Callback>
+    void ForEachRegion(Callback callback) const;
+
+    /* Get the byte profile of the module, or null if it is not computed */
+    const ByteProfile* GetProfile() const;
+
+    /* Get the relocation map, if relocated bytes are ignored */
+    const RelocationMap* GetRelocations() const;
+
+    /* Resolve a match, only permitting reads within the module
+     *
+     * @resolver The resolution program.
+     *
+     * @match The match.
+     *
+     * @result A pointer receiving the resolved (non-null) address.
+     *
+     * @return True if the match was resolved, otherwise false.
+     */
+    bool Resolve(const Resolver& resolver, const byte* match, uintptr_t* result) const;
+
+private:
+    // Private members
+    SignatureScanner mScanner;
+    std::shared_ptr<const SignatureScanner::RegionList> mRegions;
+    std::shared_ptr<const ByteProfile> mProfile;
+    const RelocationMap* mRelocations;
+    uintptr_t mStart;
+    uintptr_t mEnd;
+};
+
+/* Memory region source
+ *
+ * A single block of readable memory, such as the contents of a file or a
+ * copy of another process's memory. Matches are reported as addresses
+ * within the block.
+ */
+class MemorySource {
+public:
+    /* Construct the source of a memory block
+     *
+     * @data The start of the block, which must outlive the source.
+     *
+     * @size The size of the block in bytes.
+     */
+    MemorySource(const void* data, size_t size);
+
+    /* Iterate over the (single) region */
+    template<typename Callback>
+    void ForEachRegion(Callback callback) const;
+
+    /* Get the byte profile (always null, i.e the static profile is used) */
+    const ByteProfile* GetProfile() const;
+
+    /* Get the relocation map (always null) */
+    const RelocationMap* GetRelocations() const;
+
+    /* Resolve a match, only permitting reads within the block */
+    bool Resolve(const Resolver& resolver, const byte* match, uintptr_t* result) const;
+
+private:
+    // Private members
+    const byte* mBegin;
+    const byte* mEnd;
+};
+
+/* First match sink
+ *
+ * Keeps the first match, and stops the search.
+ */
+class FirstMatchSink {
+public:
+    FirstMatchSink();
+
+    /* Receive a match, returning whether the search should continue */
+    bool operator()(const byte* match);
+
+    /* Get the match, or null if there was none */
+    const byte* GetMatch() const;
+
+private:
+    // Private members
+    const byte* mMatch;
+};
+
+/* Match list sink
+ *
+ * Keeps every match, in ascending order.
+ */
+class MatchListSink {
+public:
+    /* Receive a match, returning whether the search should continue */
+    bool operator()(const byte* match);
+
+    /* Get the matches */
+    const std::vector<const byte*>& GetMatches() const;
+
+private:
+    // Private members
+    std::vector<const byte*> mMatches;
+};
+
+/* Policy-based signature scanner
+ *
+ * Composes a region source, a search engine and a result sink, all resolved
+ * at compile time, so the search of a region calls the engine and sink
+ * directly instead of through an interface. The default instantiation
+ * searches a module in the current process like <SignatureScanner>, with
+ * the same engine selection, byte profile, relocations and resolution
+ * (see <ModuleSource>); other sources (e.g a file read into memory, or a
+ * snapshot of a remote process) and sinks can be supplied by the user.
+ *
+ * A region source has the following methods:
+ *
+ *   - 'ForEachRegion(callback)', invoking a callable with the signature
+ *     'bool(const byte*, const byte*)' with the bounds of each readable
+ *     region in ascending order, stopping once it returns false.
+ *   - 'const ByteProfile* GetProfile() const', returning the byte profile
+ *     that anchors are selected by, or null for the static profile.
+ *   - 'const RelocationMap* GetRelocations() const', returning the map of
+ *     bytes to ignore, or null.
+ *   - 'bool Resolve(const Resolver&, const byte*, uintptr_t*) const',
+ *     resolving a match within the source's memory.
+ *
+ * An engine is constructible from a signature, a byte profile and a
+ * relocation map (both may be null), and has a method
+ * 'const byte* Find(const byte* begin, const byte* end) const' returning the
+ * first match within a block, or null.
+ *
+ * A sink is a callable with the signature 'bool(const byte*)', receiving each
+ * match in ascending order, and returning whether the search should continue.
+ */
+template<
+    typename RegionSource = ModuleSource,
+    typename Engine = SignatureEngine,
+    typename Sink = FirstMatchSink>
+class BasicScanner {
+public:
+    /* Construct a scanner of a region source
+     *
+     * @source The source of the searched regions.
+     */
+    explicit BasicScanner(RegionSource source);
+
+    /* Search for the matches of a signature
+     *
+     * Matches may overlap. The search stops once the sink returns false.
+     *
+     * @signature The signature to search for.
+     *
+     * @sink The sink receiving each match.
+     */
+    void Scan(const Signature& signature, Sink& sink) const;
+
+    /* Search for the first match of a signature
+     *
+     * @signature The signature to search for.
+     *
+     * @return The address of the match, or zero if none is found.
+     */
+    uintptr_t FindSignature(const Signature& signature) const;
+
+    /* Search for the first resolved match of a signature
+     *
+     * Matches that cannot be resolved are skipped.
+     *
+     * @signature The signature to search for.
+     *
+     * @resolver The resolution program applied to each match.
+     *
+     * @return The first resolved match, or zero if none is found.
+     */
+    uintptr_t FindSignature(const Signature& signature, const Resolver& resolver) const;
+
+    /* Search for every match of a signature
+     *
+     * @signature The signature to search for.
+     *
+     * @return The addresses of the matches, in ascending order.
+     */
+    std::vector<uintptr_t> FindAllSignatures(const Signature& signature) const;
+
+    /* Search for every resolved match of a signature
+     *
+     * Matches that cannot be resolved are skipped.
+     *
+     * @signature The signature to search for.
+     *
+     * @resolver The resolution program applied to each match.
+     *
+     * @return The resolved matches, in the order of the matches.
+     */
+    std::vector<uintptr_t> FindAllSignatures(
+        const Signature& signature,
+        const Resolver& resolver) const;
+
+    /* Get the region source */
+    const RegionSource& GetSource() const;
+
+private:
+    /* Search for the matches of a signature, with any kind of sink */
+    template<typename Target>
+    void ScanInto(const Signature& signature, Target& sink) const;
+
+    // Private members
+    RegionSource mSource;
+};
+
+inline ModuleSource::ModuleSource(
+    const SignatureScanner& scanner,
+    size_t offset /*= 0*/,
+    size_t length /*= SignatureScanner::npos*/,
+    uint flags /*= 0*/) :
+    mScanner(scanner),
+    mRegions(scanner.GetSearchableRegions()),
+    mProfile(scanner.GetCachedByteProfile()),
+    mRelocations(nullptr),
+    mStart(reinterpret_cast<uintptr_t>(scanner.GetBaseAddress()) + offset),
+    mEnd(reinterpret_cast<uintptr_t>(scanner.GetBaseAddress()) +
+      std::min(scanner.GetModuleSize(), length))
+{
+  if(flags & SignatureScanner::FunctionStarts) {
+    throw SignatureScanner::Exception("function start searches require the scanner");
+  }
+
+  // The map is cached by the module, which the copied scanner keeps alive
+  if(flags & SignatureScanner::IgnoreRelocations) {
+    mRelocations = &mScanner.GetRelocationMap();
+  }
+}
+
+template<typename Callback>
+void ModuleSource::ForEachRegion(Callback callback) const {
+  for(const std::pair<uintptr_t, uintptr_t>& region : *mRegions) {
+    const uintptr_t lower = std::max(region.first, mStart);
+    const uintptr_t upper = std::min(region.second, mEnd);
+
+    if(lower >= upper) {
+      continue;
+    }
+
+    if(!callback(reinterpret_cast<const byte*>(lower), reinterpret_cast<const byte*>(upper))) {
+      break;
+    }
+  }
+}
+
+inline const ByteProfile* ModuleSource::GetProfile() const {
+  return mProfile.get();
+}
+
+inline const RelocationMap* ModuleSource::GetRelocations() const {
+  return mRelocations;
+}
+
+inline bool ModuleSource::Resolve(
+    const Resolver& resolver,
+    const byte* match,
+    uintptr_t* result) const {
+  return mScanner.Resolve(resolver, reinterpret_cast<uintptr_t>(match), result);
+}
+
+inline MemorySource::MemorySource(const void* data, size_t size) :
+    mBegin(static_cast<const byte*>(data)),
+    mEnd(static_cast<const byte*>(data) + size)
+{
+}
+
+template<typename Callback>
+void MemorySource::ForEachRegion(Callback callback) const {
+  if(mBegin != mEnd) {
+    callback(mBegin, mEnd);
+  }
+}
+
+inline const ByteProfile* MemorySource::GetProfile() const {
+  return nullptr;
+}
+
+inline const RelocationMap* MemorySource::GetRelocations() const {
+  return nullptr;
+}
+
+inline bool MemorySource::Resolve(
+    const Resolver& resolver,
+    const byte* match,
+    uintptr_t* result) const {
+  // A null result is indistinguishable from no result at all
+  return resolver.Resolve(
+    reinterpret_cast<uintptr_t>(match),
+    reinterpret_cast<uintptr_t>(mBegin),
+    reinterpret_cast<uintptr_t>(mEnd),
+    result) && *result != 0;
+}
+
+inline FirstMatchSink::FirstMatchSink() :
+    mMatch(nullptr)
+{
+}
+
+inline bool FirstMatchSink::operator()(const byte* match) {
+  mMatch = match;
+  return false;
+}
+
+inline const byte* FirstMatchSink::GetMatch() const {
+  return mMatch;
+}
+
+inline bool MatchListSink::operator()(const byte* match) {
+  mMatches.push_back(match);
+  return true;
+}
+
+inline const std::vector<const byte*>& MatchListSink::GetMatches() const {
+  return mMatches;
+}
+
+template<typename RegionSource, typename Engine, typename Sink>
+BasicScanner<RegionSource, Engine, Sink>::BasicScanner(RegionSource source) :
+    mSource(std::move(source))
+{
+}
+
+template<typename RegionSource, typename Engine, typename Sink>
+void BasicScanner<RegionSource, Engine, Sink>::Scan(
+    const Signature& signature,
+    Sink& sink) const {
+  this->ScanInto(signature, sink);
+}
+
+template<typename RegionSource, typename Engine, typename Sink>
+uintptr_t BasicScanner<RegionSource, Engine, Sink>::FindSignature(
+    const Signature& signature) const {
+  FirstMatchSink sink;
+  this->ScanInto(signature, sink);
+
+  return reinterpret_cast<uintptr_t>(sink.GetMatch());
+}
+
+template<typename RegionSource, typename Engine, typename Sink>
+uintptr_t BasicScanner<RegionSource, Engine, Sink>::FindSignature(
+    const Signature& signature,
+    const Resolver& resolver) const {
+  uintptr_t result = 0;
+
+  auto sink = [&](const byte* match) {
+    uintptr_t resolved = 0;
+
+    if(mSource.Resolve(resolver, match, &resolved)) {
+      result = resolved;
+      return false;
+    }
+
+    return true;
+  };
+
+  this->ScanInto(signature, sink);
+  return result;
+}
+
+template<typename RegionSource, typename Engine, typename Sink>
+std::vector<uintptr_t> BasicScanner<RegionSource, Engine, Sink>::FindAllSignatures(
+    const Signature& signature) const {
+  std::vector<uintptr_t> results;
+
+  auto sink = [&](const byte* match) {
+    results.push_back(reinterpret_cast<uintptr_t>(match));
+    return true;
+  };
+
+  this->ScanInto(signature, sink);
+  return results;
+}
+
+template<typename RegionSource, typename Engine, typename Sink>
+std::vector<uintptr_t> BasicScanner<RegionSource, Engine, Sink>::FindAllSignatures(
+    const Signature& signature,
+    const Resolver& resolver) const {
+  std::vector<uintptr_t> results;
+
+  auto sink = [&](const byte* match) {
+    uintptr_t resolved = 0;
+
+    if(mSource.Resolve(resolver, match, &resolved)) {
+      results.push_back(resolved);
+    }
+
+    return true;
+  };
+
+  this->ScanInto(signature, sink);
+  return results;
+}
+
+template<typename RegionSource, typename Engine, typename Sink>
+const RegionSource& BasicScanner<RegionSource, Engine, Sink>::GetSource() const {
+  return mSource;
+}
+
+template<typename RegionSource, typename Engine, typename Sink>
+template<typename Target>
+void BasicScanner<RegionSource, Engine, Sink>::ScanInto(
+    const Signature& signature,
+    Target& sink) const {
+  const Engine engine(signature, mSource.GetProfile(), mSource.GetRelocations());
+
+  mSource.ForEachRegion([&](const byte* begin, const byte* end) {
+    for(const byte* position = begin; position < end; position++) {
+      position = engine.Find(position, end);
+
+      if(position == nullptr) {
+        break;
+      }
+
+      if(!sink(position)) {
+        return false;
+      }
+    }
+
+    return true;
+  });
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
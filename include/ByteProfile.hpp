@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace {
+typedef unsigned char byte;
+typedef unsigned int  uint;
+typedef unsigned long ulong;
+}
+
+/* Byte frequency profile
+ *
+ * A histogram of how often every byte value, and every pair of adjacent byte
+ * values, occurs within a module. The signature scanner uses it to choose the
+ * rarest part of a signature as the candidate filter (i.e the anchor), since
+ * the fewer times the anchor occurs, the fewer full comparisons are needed.
+ *
+ * A default constructed profile is empty. The static profile is derived from
+ * typical x86 machine code and is used before a module has been profiled.
+ */
+class ByteProfile {
+public:
+    /* Construct an empty profile */
+    ByteProfile();
+
+    /* Add a memory block to the profile
+     *
+     * Every byte, and every pair of adjacent bytes, within the block is
+     * counted. Pairs are never counted across two separate blocks.
+     *
+     * @data A pointer to the start of the block.
+     *
+     * @size The size of the block in bytes.
+     */
+    void Add(const byte* data, size_t size);
+
+    /* Get the relative frequency of a byte
+     *
+     * @value The byte value of interest.
+     *
+     * @return The frequency of the value, in the range [0, 1].
+     */
+    double GetByteFrequency(byte value) const;
+
+    /* Get the relative frequency of a byte pair
+     *
+     * If the profile has no pair information (e.g the static profile) the
+     * frequency is estimated from the frequency of the individual bytes.
+     *
+     * @first The byte value at the lower address.
+     *
+     * @second The byte value at the higher address.
+     *
+     * @return The frequency of the pair, in the range [0, 1].
+     */
+    double GetPairFrequency(byte first, byte second) const;
+
+    /* Get the number of bytes that have been profiled
+     *
+     * @return The total number of bytes added to the profile.
+     */
+    uint64_t GetByteCount() const;
+
+    /* Get the static x86 profile
+     *
+     * The static profile is used when no module specific profile exists. Its
+     * byte frequencies are derived from common x86-64 code sections.
+     *
+     * @return A reference to the shared static profile.
+     */
+    static const ByteProfile& GetStaticProfile();
+
+private:
+    // Private members
+    std::vector<uint64_t> mBytes;
+    std::vector<uint64_t> mPairs;
+    uint64_t mByteCount;
+    uint64_t mPairCount;
+};
+
+/* vim: set ts=2 sw=2 expandtab: */
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+/* Cancellation token
+ *
+ * A flag shared between the copies of a token, used to request that an
+ * operation is abandoned. The operation checks the token at its own pace
+ * (e.g once per memory region, or chunk of a region).
+ */
+class CancellationToken {
+public:
+    /* Construct a token that has not been cancelled */
+    CancellationToken();
+
+    /* Request cancellation of every operation observing the token */
+    void Cancel() const;
+
+    /* Check if cancellation has been requested
+     *
+     * @return True if the token, or a copy of it, has been cancelled.
+     */
+    bool IsCancelled() const;
+
+private:
+    // Private members
+    std::shared_ptr<std::atomic<bool>> mCancelled;
+};
+
+inline CancellationToken::CancellationToken() :
+    mCancelled(std::make_shared<std::atomic<bool>>(false)) {
+}
+
+inline void CancellationToken::Cancel() const {
+  mCancelled->store(true, std::memory_order_relaxed);
+}
+
+inline bool CancellationToken::IsCancelled() const {
+  return mCancelled->load(std::memory_order_relaxed);
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+typedef unsigned char byte;
+}
+
+/* Function fingerprint index
+ *
+ * An index of the functions within a module, keyed by a hash of their
+ * normalized bytes (see <Fingerprint>); bytes that differ between builds or
+ * runs, such as relocated fields and relative (rel32) operands, are zeroed.
+ * A function whose normalized bytes are known can then be located with a
+ * lookup instead of a search, and the functions that changed between two
+ * builds are those whose fingerprints differ.
+ *
+ * Functions are stored relative to the module base, so an index can be saved
+ * and reused by another process loading the same build (identified by its
+ * build ID).
+ */
+class FingerprintIndex {
+public:
+    /* Describes a function */
+    struct Function {
+        /* The hash of the normalized bytes */
+        uint64_t fingerprint;
+
+        /* The start of the function, relative to the module base */
+        size_t offset;
+
+        /* The number of bytes of code in the function */
+        size_t size;
+    };
+
+    /* Construct an empty index
+     *
+     * @buildId The build ID of the module, as a hex string (may be empty).
+     */
+    explicit FingerprintIndex(const std::string& buildId = std::string());
+
+    /* Add a function to the index
+     *
+     * Functions must be added in ascending order of their offset.
+     *
+     * @function The function to add.
+     */
+    void Add(const Function& function);
+
+    /* Find the first function with a fingerprint
+     *
+     * @fingerprint The hash of the function's normalized bytes.
+     *
+     * @return A pointer to the function, otherwise null.
+     */
+    const Function* Find(uint64_t fingerprint) const;
+
+    /* Find every function with a fingerprint
+     *
+     * Identical functions (e.g trivial ones) share their fingerprint.
+     *
+     * @fingerprint The hash of the function's normalized bytes.
+     *
+     * @return Pointers to the functions, in ascending order.
+     */
+    std::vector<const Function*> FindAll(uint64_t fingerprint) const;
+
+    /* Find the functions without a counterpart in another index
+     *
+     * @other The index of another build (e.g the previous one).
+     *
+     * @return Pointers to the functions whose fingerprints are not present
+     *         in the other index, in ascending order.
+     */
+    std::vector<const Function*> FindChanged(const FingerprintIndex& other) const;
+
+    /* Get every indexed function, in ascending order */
+    const std::vector<Function>& GetFunctions() const;
+
+    /* Get the build ID of the indexed module */
+    const std::string& GetBuildId() const;
+
+    /* Write the index to a (binary) stream
+     *
+     * @stream The output stream.
+     *
+     * @return True if the index was written, otherwise false.
+     */
+    bool Save(std::ostream& stream) const;
+
+    /* Read an index from a (binary) stream
+     *
+     * @stream The input stream, as written by <Save>.
+     *
+     * @index The index to populate, which must be empty.
+     *
+     * @return True if a valid index was read, otherwise false.
+     */
+    static bool Load(std::istream& stream, FingerprintIndex* index);
+
+    /* Compute the fingerprint of normalized bytes
+     *
+     * A 64-bit FNV-1a hash of the size and the bytes, where every byte with
+     * a clear mask is hashed as zero.
+     *
+     * @code The bytes of the function.
+     *
+     * @masks The masks of the bytes (0xFF to include, 0x00 to ignore), or
+     *        null to include every byte.
+     *
+     * @size The number of bytes.
+     *
+     * @return The fingerprint.
+     */
+    static uint64_t Fingerprint(const byte* code, const byte* masks, size_t size);
+
+private:
+    // Private members
+    std::string mBuildId;
+    std::vector<Function> mFunctions;
+    std::unordered_multimap<uint64_t, size_t> mFingerprints;
+};
+
+inline const std::vector<FingerprintIndex::Function>& FingerprintIndex::GetFunctions() const {
+  return mFunctions;
+}
+
+inline const std::string& FingerprintIndex::GetBuildId() const {
+  return mBuildId;
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* Function index
+ *
+ * An index of the function boundaries within a module, as described by its
+ * unwind information. Functions are kept in ascending order of their start
+ * address, and never overlap.
+ */
+class FunctionIndex {
+public:
+    /* Describes a function */
+    struct Function {
+        /* The start (entry point) of the function */
+        uintptr_t address;
+
+        /* The number of bytes of code in the function */
+        size_t size;
+    };
+
+    /* Add a function to the index
+     *
+     * Functions must be added in ascending order of their start address.
+     *
+     * @function The function to add.
+     */
+    void Add(const Function& function);
+
+    /* Find the function containing an address
+     *
+     * @address An address within the function.
+     *
+     * @return A pointer to the function, otherwise null.
+     */
+    const Function* Find(uintptr_t address) const;
+
+    /* Find the first function starting at or after an address
+     *
+     * @address The lower bound of the function's start address.
+     *
+     * @return An iterator to the function, or to the end of <GetFunctions>.
+     */
+    std::vector<Function>::const_iterator LowerBound(uintptr_t address) const;
+
+    /* Get every indexed function, in ascending order */
+    const std::vector<Function>& GetFunctions() const;
+
+private:
+    // Private members
+    std::vector<Function> mFunctions;
+};
+
+inline const std::vector<FunctionIndex::Function>& FunctionIndex::GetFunctions() const {
+  return mFunctions;
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
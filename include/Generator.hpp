@@ -0,0 +1,120 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#include <utility>
+
+/* Lazily evaluated sequence
+ *
+ * The result type of a coroutine that yields values. The coroutine only runs
+ * while the consumer advances an iterator, so the values are produced one at
+ * a time and abandoning the iteration abandons the remaining work. Exceptions
+ * thrown by the coroutine are rethrown when advancing. Requires C++20.
+ */
+template<typename T>
+class Generator {
+public:
+    /* The coroutine state (required by the language) */
+    struct promise_type {
+        Generator get_return_object() {
+          return Generator(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() { exception = std::current_exception(); }
+
+        std::suspend_always yield_value(T yielded) {
+          value = std::move(yielded);
+          return {};
+        }
+
+        T value{};
+        std::exception_ptr exception;
+    };
+
+    typedef std::coroutine_handle<promise_type> Handle;
+
+    /* Input iterator over the yielded values */
+    class Iterator {
+    public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef std::ptrdiff_t difference_type;
+        typedef T value_type;
+
+        Iterator() = default;
+        explicit Iterator(Handle handle) : mHandle(handle) {}
+
+        const T& operator*() const { return mHandle.promise().value; }
+        Iterator& operator++() { Generator::Advance(mHandle); return *this; }
+        void operator++(int) { ++*this; }
+
+        bool operator==(std::default_sentinel_t) const { return mHandle.done(); }
+
+    private:
+        Handle mHandle;
+    };
+
+    Generator(Generator&& other) noexcept : mHandle(std::exchange(other.mHandle, nullptr)) {}
+    Generator& operator=(Generator&& other) noexcept;
+    Generator(const Generator&) = delete;
+    Generator& operator=(const Generator&) = delete;
+    ~Generator();
+
+    /* Run the coroutine until its first value
+     *
+     * May only be called once.
+     */
+    Iterator begin();
+
+    /* Get the end of the sequence */
+    std::default_sentinel_t end() const { return {}; }
+
+private:
+    explicit Generator(Handle handle) : mHandle(handle) {}
+
+    /* Resume the coroutine until it yields or finishes */
+    static void Advance(Handle handle);
+
+    // Private members
+    Handle mHandle;
+};
+
+template<typename T>
+Generator<T>& Generator<T>::operator=(Generator&& other) noexcept {
+  if(this != &other) {
+    if(mHandle) {
+      mHandle.destroy();
+    }
+
+    mHandle = std::exchange(other.mHandle, nullptr);
+  }
+
+  return *this;
+}
+
+template<typename T>
+Generator<T>::~Generator() {
+  if(mHandle) {
+    mHandle.destroy();
+  }
+}
+
+template<typename T>
+typename Generator<T>::Iterator Generator<T>::begin() {
+  Advance(mHandle);
+  return Iterator(mHandle);
+}
+
+template<typename T>
+void Generator<T>::Advance(Handle handle) {
+  handle.resume();
+
+  if(handle.promise().exception) {
+    std::rethrow_exception(std::exchange(handle.promise().exception, nullptr));
+  }
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <bitset>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+typedef unsigned char byte;
+typedef unsigned int  uint;
+typedef unsigned long ulong;
+}
+
+/* Compiled search pattern
+ *
+ * A pattern is a more expressive alternative to a <Signature>. In addition to
+ * bytes with nibble wildcards, it supports byte sets, alternation and bounded
+ * gaps. The pattern is compiled into a deterministic automaton, which is used
+ * to verify candidate positions. Candidates are found by searching for the
+ * longest literal byte sequence that every match must contain (a literal
+ * factor), or by the set of possible first bytes if no such literal exists.
+ *
+ * The syntax consists of whitespace separated elements:
+ *
+ *   8B, 4?, ??, ?       A byte, with optional nibble or byte wildcards
+ *   05&C7               A byte compared by an explicit bit mask
+ *   {48 49 4C-4F}       A set of bytes, including ranges
+ *   {^00 FF}            A negated set of bytes
+ *   [4], [2-6]          A gap of exactly 4, or 2 to 6, arbitrary bytes
+ *   (E8 | FF 15)        Alternation between sequences
+ *
+ * Example: "(48 8B | 4C 8B) 05 ? ? ? ? [0-8] {E8 E9}"
+ */
+class Pattern {
+public:
+    /* Pattern exception */
+    class Exception : public std::runtime_error {
+    public:
+        explicit Exception(std::string error) : runtime_error(error.c_str()) {}
+    };
+
+    /* Compile a textual pattern
+     *
+     * An <Exception> is thrown if the pattern is malformed, or if it can
+     * match an empty sequence of bytes.
+     *
+     * @pattern The textual pattern, see the class description.
+     */
+    explicit Pattern(const std::string& pattern);
+
+    /* Find the first match within a memory block
+     *
+     * @begin The start of the block.
+     *
+     * @end The end of the block (exclusive). A match never extends past it.
+     *
+     * @return The start of the first match, otherwise null.
+     */
+    const byte* Find(const byte* begin, const byte* end) const;
+
+    /* Check if the pattern matches at the start of a memory block
+     *
+     * @begin The start of the block, which is also the start of the match.
+     *
+     * @end The end of the block (exclusive). A match never extends past it.
+     *
+     * @return The end of the shortest match, otherwise null.
+     */
+    const byte* Matches(const byte* begin, const byte* end) const;
+
+    /* Get the minimum number of bytes a match spans */
+    size_t GetMinLength() const;
+
+    /* Get the maximum number of bytes a match spans */
+    size_t GetMaxLength() const;
+
+private:
+    /* The compiled automaton (see the implementation) */
+    struct Automaton;
+
+    // Private members
+    std::shared_ptr<const Automaton> mAutomaton;
+    std::vector<byte> mLiteral;
+    std::bitset<256> mFirstBytes;
+    size_t mLiteralAnchor;
+    size_t mMinPrefix;
+    size_t mMaxPrefix;
+    size_t mMinLength;
+    size_t mMaxLength;
+};
+
+inline size_t Pattern::GetMinLength() const {
+  return mMinLength;
+}
+
+inline size_t Pattern::GetMaxLength() const {
+  return mMaxLength;
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
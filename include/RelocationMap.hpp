@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace {
+typedef unsigned char byte;
+typedef unsigned int  uint;
+typedef unsigned long ulong;
+}
+
+/* Relocation bitmap
+ *
+ * Describes which bytes of a module are patched by the dynamic loader. There
+ * is one bit for every byte of the module, set if the byte is part of a
+ * relocated field. Relocated bytes differ between runs (e.g due to ASLR), so
+ * the scanner can treat them as wildcards.
+ */
+class RelocationMap {
+public:
+    /* Construct an empty relocation map
+     *
+     * @baseAddress The base address of the module.
+     *
+     * @size The size of the module in bytes.
+     */
+    RelocationMap(uintptr_t baseAddress, size_t size);
+
+    /* Mark a relocated field
+     *
+     * Fields (or parts of fields) outside of the module are ignored.
+     *
+     * @address The address of the relocated field.
+     *
+     * @size The size of the relocated field in bytes.
+     */
+    void Add(uintptr_t address, size_t size);
+
+    /* Check if a byte is relocated
+     *
+     * @address The address of the byte of interest.
+     *
+     * @return True if the byte is part of a relocated field.
+     */
+    bool IsRelocated(uintptr_t address) const;
+
+    /* Find the next relocated byte
+     *
+     * @start The lower bound of the search (inclusive).
+     *
+     * @end The upper bound of the search (exclusive).
+     *
+     * @return The address of the first relocated byte, otherwise zero.
+     */
+    uintptr_t FindNext(uintptr_t start, uintptr_t end) const;
+
+    /* Get the number of relocated fields that have been added */
+    size_t GetCount() const;
+
+private:
+    // Private members
+    std::vector<uint64_t> mBits;
+    uintptr_t mBaseAddress;
+    size_t mSize;
+    size_t mCount;
+};
+
+inline bool RelocationMap::IsRelocated(uintptr_t address) const {
+  const uintptr_t offset = address - mBaseAddress;
+
+  if(address < mBaseAddress || offset >= mSize) {
+    return false;
+  }
+
+  return (mBits[offset / 64] >> (offset % 64)) & 1;
+}
+
+inline size_t RelocationMap::GetCount() const {
+  return mCount;
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
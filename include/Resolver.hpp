@@ -0,0 +1,178 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/* Match resolution program
+ *
+ * A match address is rarely the value of interest; it is usually the
+ * location of an instruction that refers to it. A resolver describes a
+ * sequence of steps that transforms a match into the value of interest. The
+ * steps are applied in the order they were added. For example, resolving the
+ * target of a 'call rel32' located four bytes into a match:
+ *
+ *   Resolver().Offset(4).Relative32(1, 5)
+ *
+ * Or the value of a global read with 'mov rax, [rip + rel32]' at the match:
+ *
+ *   Resolver().Relative32(3, 7).Dereference()
+ */
+class Resolver {
+public:
+    /* Add a constant to the address
+     *
+     * @offset The (signed) distance to add.
+     *
+     * @return A reference to the resolver.
+     */
+    Resolver& Offset(ptrdiff_t offset);
+
+    /* Follow a signed 8-bit relative operand
+     *
+     * The address is assumed to be the start of an instruction, and becomes
+     * the end of the instruction plus the operand.
+     *
+     * @operand The offset of the operand within the instruction.
+     *
+     * @length The total length of the instruction.
+     *
+     * @return A reference to the resolver.
+     */
+    Resolver& Relative8(size_t operand, size_t length);
+
+    /* Follow a signed 32-bit relative operand
+     *
+     * Behaves like <Relative8>, but for 32-bit operands (e.g 'call rel32',
+     * 'jmp rel32' or RIP-relative addressing).
+     *
+     * @operand The offset of the operand within the instruction.
+     *
+     * @length The total length of the instruction.
+     *
+     * @return A reference to the resolver.
+     */
+    Resolver& Relative32(size_t operand, size_t length);
+
+    /* Read a pointer at the address
+     *
+     * @return A reference to the resolver.
+     */
+    Resolver& Dereference();
+
+    /* Resolve an address
+     *
+     * Every read performed by the program must lie within the supplied
+     * bounds, otherwise the resolution fails.
+     *
+     * @address The address to resolve (e.g a match).
+     *
+     * @lower The lower bound of readable memory (inclusive).
+     *
+     * @upper The upper bound of readable memory (exclusive).
+     *
+     * @result A pointer receiving the resolved address.
+     *
+     * @return True if the address was resolved, otherwise false.
+     */
+    bool Resolve(
+        uintptr_t address,
+        uintptr_t lower,
+        uintptr_t upper,
+        uintptr_t* result) const;
+
+    /* Resolve an address, validating reads with a predicate
+     *
+     * @address The address to resolve (e.g a match).
+     *
+     * @readable A callable with the signature 'bool(uintptr_t, size_t)',
+     *           returning whether a read of a size at an address is valid.
+     *
+     * @result A pointer receiving the resolved address.
+     *
+     * @return True if the address was resolved, otherwise false.
+     */
+    template<typename Predicate>
+    bool Resolve(
+        uintptr_t address,
+        Predicate readable,
+        uintptr_t* result) const;
+
+    /* Check if the program has no steps */
+    bool IsEmpty() const;
+
+    /* A single step of the program
+     *
+     * The value is the offset of an <Offset>, or the operand offset of a
+     * relative step; the length is the instruction length of a relative step.
+     */
+    struct Step {
+        enum Type { Offset, Relative8, Relative32, Dereference };
+
+        Type type;
+        ptrdiff_t value;
+        size_t length;
+    };
+
+    /* Get the steps of the program, in order */
+    const std::vector<Step>& GetSteps() const;
+
+private:
+    // Private members
+    std::vector<Step> mSteps;
+};
+
+inline bool Resolver::IsEmpty() const {
+  return mSteps.empty();
+}
+
+inline const std::vector<Resolver::Step>& Resolver::GetSteps() const {
+  return mSteps;
+}
+
+template<typename Predicate>
+bool Resolver::Resolve(
+    uintptr_t address,
+    Predicate readable,
+    uintptr_t* result) const {
+  for(const Step& step : mSteps) {
+    switch(step.type) {
+    case Step::Offset:
+      address += step.value;
+      break;
+    case Step::Relative8: {
+      if(!readable(address + step.value, sizeof(int8_t))) {
+        return false;
+      }
+
+      int8_t displacement;
+      memcpy(&displacement, reinterpret_cast<const void*>(address + step.value), sizeof(displacement));
+      address += step.length + displacement;
+      break;
+    }
+    case Step::Relative32: {
+      if(!readable(address + step.value, sizeof(int32_t))) {
+        return false;
+      }
+
+      int32_t displacement;
+      memcpy(&displacement, reinterpret_cast<const void*>(address + step.value), sizeof(displacement));
+      address += step.length + displacement;
+      break;
+    }
+    case Step::Dereference:
+      if(!readable(address, sizeof(uintptr_t))) {
+        return false;
+      }
+
+      memcpy(&address, reinterpret_cast<const void*>(address), sizeof(address));
+      break;
+    }
+  }
+
+  *result = address;
+  return true;
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+/* Shared result cache
+ *
+ * A table of search results in a named shared memory segment, which every
+ * process (of the same user) on the host can open, populate and read.
+ * Results are keyed by a 64-bit hash, e.g of a module's build ID and a
+ * search (see <SignatureScanner::SetResultCache>), and stored as offsets
+ * relative to the module base, so they hold in every process that loads the
+ * same build, wherever it is mapped.
+ *
+ * The table uses open addressing with linear probing, and is lock-free: a
+ * slot is claimed by atomically setting its key, and its offset is published
+ * afterwards. A slot that is claimed but not yet published reads as a miss.
+ * Entries are never removed; once the table is full, inserts fail.
+ */
+class ResultCache {
+public:
+    /* Result cache exception */
+    class Exception : public std::runtime_error {
+    public:
+        explicit Exception(std::string error) : runtime_error(error.c_str()) {}
+    };
+
+    /* The offset stored for a search without a match */
+    static const size_t npos = -1;
+
+    /* The default number of slots in a new table */
+    static const size_t DefaultCapacity = 4096;
+
+    /* Open a cache, creating it if it does not exist
+     *
+     * The capacity of an existing cache is kept. An <Exception> is thrown if
+     * the segment cannot be created or mapped, or is not a valid cache.
+     * A segment left empty by a creator that died before sizing it is
+     * replaced after a short wait; any other invalid cache must be removed
+     * (see <Remove>).
+     *
+     * @name The name of the segment (e.g the name of the service).
+     *
+     * @capacity The number of slots in a new table, rounded up to a power
+     *           of two.
+     */
+    explicit ResultCache(const std::string& name, size_t capacity = DefaultCapacity);
+
+    /* Look up a result
+     *
+     * @key The key of the result (must not be zero).
+     *
+     * @offset A pointer receiving the offset, or <npos> if the search had no
+     *         match.
+     *
+     * @return True if the result was found, otherwise false.
+     */
+    bool Find(uint64_t key, size_t* offset) const;
+
+    /* Store a result
+     *
+     * A result that is already stored is overwritten.
+     *
+     * @key The key of the result (must not be zero).
+     *
+     * @offset The offset, or <npos> if the search had no match.
+     *
+     * @return True if the result was stored, or false if the table is full.
+     */
+    bool Insert(uint64_t key, size_t offset);
+
+    /* Get the number of slots in the table */
+    size_t GetCapacity() const;
+
+    /* Remove a cache from the host
+     *
+     * The segment is destroyed once every process has closed it; caches
+     * opened by the name afterwards are new (and empty). On Windows, this
+     * happens when the last cache is closed, so this has no effect.
+     *
+     * @name The name of the segment.
+     *
+     * @return True if the cache was removed (or did not exist).
+     */
+    static bool Remove(const std::string& name);
+
+private:
+    /* A slot of the table */
+    struct Slot;
+
+    // Private members
+    std::shared_ptr<void> mMapping;
+    Slot* mSlots;
+    size_t mCapacity;
+};
+
+inline size_t ResultCache::GetCapacity() const {
+  return mCapacity;
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
+/* Scan statistics
+ *
+ * Accumulates counters and per-signature latencies of the searches made by a
+ * scanner that the statistics are attached to (see
+ * <SignatureScanner::SetStatistics>). The statistics may be shared by
+ * several scanners, and queried while searches are in progress.
+ */
+class ScanStatistics {
+public:
+    /* The number of latency histogram buckets */
+    static const size_t HistogramSize = 32;
+
+    /* Counters of one or several searches */
+    struct Counters {
+        /* The number of bytes searched */
+        uint64_t bytesScanned;
+
+        /* The number of memory regions searched */
+        uint64_t regionsVisited;
+
+        /* The number of memory regions skipped (inaccessible or ineligible) */
+        uint64_t regionsSkipped;
+
+        /* The time spent retrieving memory region information */
+        uint64_t regionLookupNanoseconds;
+
+        /* The number of anchor occurrences */
+        uint64_t candidates;
+
+        /* The number of complete signature comparisons */
+        uint64_t verifications;
+
+        /* The number of matches (before resolving them) */
+        uint64_t matches;
+
+        Counters();
+
+        /* Add the counters of another search */
+        Counters& operator+=(const Counters& other);
+    };
+
+    /* Latency distribution of a signature
+     *
+     * Bucket 'i' counts the searches that took less than '2^i' microseconds
+     * (and at least '2^(i - 1)'); the last bucket counts every slower search.
+     */
+    struct Latency {
+        uint64_t count;
+        uint64_t totalNanoseconds;
+        uint64_t maxNanoseconds;
+        uint64_t histogram[HistogramSize];
+
+        Latency();
+    };
+
+    /* Add the counters of a search */
+    void Record(const Counters& counters);
+
+    /* Add the duration of a search for a signature
+     *
+     * @signature The textual pattern of the signature.
+     *
+     * @nanoseconds The duration of the search.
+     */
+    void RecordLatency(const std::string& signature, uint64_t nanoseconds);
+
+    /* Get the accumulated counters */
+    Counters GetCounters() const;
+
+    /* Get the latency of every recorded signature, keyed by its pattern */
+    std::map<std::string, Latency> GetLatencies() const;
+
+    /* Reset every counter and latency */
+    void Reset();
+
+    /* Serialize the statistics as a JSON object */
+    std::string ToJson() const;
+
+    /* Get the counters of the last search on the calling thread
+     *
+     * Only searches made by a scanner with statistics attached are counted.
+     */
+    static Counters GetLastScan();
+
+    /* Set the counters of the last search on the calling thread */
+    static void SetLastScan(const Counters& counters);
+
+private:
+    // Private members
+    mutable std::mutex mMutex;
+    Counters mCounters;
+    std::map<std::string, Latency> mLatencies;
+};
+
+/* vim: set ts=2 sw=2 expandtab: */
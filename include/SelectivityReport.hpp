@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+typedef unsigned char byte;
+}
+
+/* Selectivity report of a signature
+ *
+ * Describes how much work a signature causes when searched for within a
+ * module, and how it could be made cheaper (see
+ * <SignatureScanner::ProfileSignatures>).
+ */
+struct SelectivityReport {
+    /* The textual pattern of the signature */
+    std::string signature;
+
+    /* The anchor used by searches (index and length in bytes, zero length
+     * if the signature has no complete bytes) */
+    size_t anchorIndex;
+    size_t anchorLength;
+
+    /* The number of anchor occurrences, i.e verified candidates */
+    uint64_t anchorHits;
+
+    /* The number of matches */
+    uint64_t matches;
+
+    /* The number of failed verifications, by the index of the first
+     * mismatching byte */
+    std::vector<uint64_t> failures;
+
+    /* The time spent searching for the signature */
+    uint64_t nanoseconds;
+
+    /* The share of the total time of the profiling run (0 to 1) */
+    double timeShare;
+
+    /* The cheapest anchor according to the module's actual bytes, and its
+     * estimated number of occurrences */
+    size_t suggestedAnchorIndex;
+    size_t suggestedAnchorLength;
+    uint64_t suggestedAnchorHits;
+
+    /* Incompletely compared bytes that have the same value in every match
+     * (of at least two), as index and value pairs; fixing them makes the
+     * signature stricter. Bytes patched by the loader, or within relative
+     * operands referring to the module, are never suggested. */
+    std::vector<std::pair<size_t, byte>> tightenings;
+
+    SelectivityReport();
+
+    /* Describe the report and its suggestions in a human readable form */
+    std::string ToString() const;
+};
+
+/* vim: set ts=2 sw=2 expandtab: */
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Signature.hpp"
+
+/* Bit-parallel (shift-or) signature search
+ *
+ * Keeps the state of every partial match of a signature in a single word;
+ * bit 'i' is clear while the last 'i + 1' bytes match the first 'i + 1'
+ * bytes of the signature. Each byte value has a precomputed word in which
+ * bit 'i' is clear if the value matches signature byte 'i' (wildcards match
+ * every value), so each input byte costs one table lookup, shift and or,
+ * regardless of the number of wildcards. This suits signatures without a
+ * selective anchor. Signatures are limited to 64 bytes.
+ */
+class ShiftOr {
+public:
+    /* The maximum number of bytes in a signature */
+    static const size_t MaxSize = 64;
+
+    /* Construct the search tables of a signature
+     *
+     * @signature A signature of at most <MaxSize> bytes.
+     */
+    explicit ShiftOr(const Signature& signature);
+
+    /* Find the first match of the signature within a memory block
+     *
+     * @begin The start of the memory block.
+     *
+     * @end The end of the memory block (exclusive).
+     *
+     * @return The start of the first match, or null if none is found.
+     */
+    const byte* Find(const byte* begin, const byte* end) const;
+
+private:
+    // Private members
+    uint64_t mMasks[256];
+    uint64_t mAccept;
+    size_t mSize;
+};
+
+/* vim: set ts=2 sw=2 expandtab: */
@@ -0,0 +1,219 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace {
+typedef unsigned char byte;
+typedef unsigned int  uint;
+typedef unsigned long ulong;
+}
+
+/* Compiled signature
+ *
+ * A signature is a sequence of value and mask pairs. A byte in memory matches
+ * a signature byte if '(data & mask) == value'. A mask of 0xFF compares the
+ * entire byte, whilst a mask of 0x00 ignores it. Any other mask compares
+ * individual bits; e.g a mask of 0xF0 only compares the upper nibble, which
+ * allows patterns such as '4?' (any REX prefix).
+ *
+ * Values are always stored with the masked out bits cleared.
+ */
+class Signature {
+public:
+    /* Signature exception */
+    class Exception : public std::runtime_error {
+    public:
+        explicit Exception(std::string error) : runtime_error(error.c_str()) {}
+    };
+
+    /* Construct a signature from a byte mask
+     *
+     * @values The byte values of the signature.
+     *
+     * @mask A null-terminated character array with an equal length compared
+     *       to the values. A question mark character ignores the respective
+     *       byte, any other character includes it.
+     */
+    Signature(const std::vector<byte>& values, const char* mask);
+
+    /* Construct a signature from value and mask pairs
+     *
+     * @values The byte values of the signature.
+     *
+     * @masks The bit masks of the signature, with an equal length compared to
+     *        the values.
+     */
+    Signature(const std::vector<byte>& values, const std::vector<byte>& masks);
+
+    /* Construct a signature from a textual pattern
+     *
+     * The pattern consists of whitespace separated bytes, each described by
+     * two hex digits. A digit can be replaced by a question mark to ignore
+     * that nibble, and a single question mark ignores an entire byte. An
+     * explicit bit mask can be supplied by suffixing a byte with an ampersand
+     * and the mask (e.g '05&C7'). An <Exception> is thrown if the pattern is
+     * malformed.
+     *
+     * Example: "4? 8B 05 ? ? ? ? C0&F8"
+     *
+     * @pattern The textual signature pattern.
+     */
+    explicit Signature(const std::string& pattern);
+
+    /* Construct a signature from a byte mask, without copying into vectors
+     *
+     * Signatures of up to <MaxVectorSize> bytes are stored inline, so their
+     * construction and use never allocates.
+     *
+     * @values A pointer to the byte values of the signature.
+     *
+     * @mask A character array of the same length as the values (it need
+     *       not be null-terminated). A question mark character ignores the
+     *       respective byte, any other character includes it.
+     *
+     * @size The number of bytes in the signature.
+     */
+    Signature(const byte* values, const char* mask, size_t size);
+
+    /* Construct a signature from value and mask pairs, without copying into
+     * vectors (see above)
+     *
+     * @values A pointer to the byte values of the signature.
+     *
+     * @masks A pointer to the bit masks of the signature.
+     *
+     * @size The number of bytes in the signature.
+     */
+    Signature(const byte* values, const byte* masks, size_t size);
+
+    /* Construct a signature from a mask bitmap, without copying into vectors
+     * (see above)
+     *
+     * @values A pointer to the byte values of the signature.
+     *
+     * @bitmap One bit per byte of the signature, set to include the byte;
+     *         bit 'i % 64' of word 'i / 64' describes byte 'i'.
+     *
+     * @size The number of bytes in the signature.
+     */
+    Signature(const byte* values, const uint64_t* bitmap, size_t size);
+
+    /* Check if a memory block matches the signature
+     *
+     * Signatures of up to <MaxVectorSize> bytes are compared as a whole with
+     * one or two vector compares (AVX-512BW or AVX2, if available). Such
+     * compares never read past the page of the last byte of the block.
+     *
+     * @data A pointer to at least <GetSize> readable bytes.
+     *
+     * @return True if the data matches, otherwise false.
+     */
+    bool Matches(const byte* data) const;
+
+    /* Convert the signature into a textual pattern
+     *
+     * The result is accepted by the textual pattern constructor, e.g
+     * "4? 8B 05 ? ? ? ? C0&F8".
+     *
+     * @return The textual pattern of the signature.
+     */
+    std::string ToString() const;
+
+    /* Get the number of bytes in the signature */
+    size_t GetSize() const;
+
+    /* Get the (masked) byte values of the signature */
+    const byte* GetValues() const;
+
+    /* Get the bit masks of the signature */
+    const byte* GetMasks() const;
+
+    /* Restrict the signature to aligned addresses
+     *
+     * Only addresses congruent to the remainder modulo the alignment can
+     * match; e.g an alignment of 16 (and a remainder of zero) for function
+     * entry points. Searches then only test the eligible positions. An
+     * <Exception> is thrown if the alignment is zero, or not greater than
+     * the remainder.
+     *
+     * @alignment The alignment of a match (one for any address).
+     *
+     * @remainder The offset of a match from an aligned address.
+     */
+    void SetAlignment(size_t alignment, size_t remainder = 0);
+
+    /* Get the alignment of a match (one by default) */
+    size_t GetAlignment() const;
+
+    /* Get the offset of a match from an aligned address */
+    size_t GetAlignmentRemainder() const;
+
+    /* Check if an address is eligible for a match (see <SetAlignment>) */
+    bool IsAligned(const byte* data) const;
+
+    /* The largest signature that is compared as a whole */
+    static const size_t MaxVectorSize = 64;
+
+private:
+    /* Allocate the (zeroed) storage of the values and masks */
+    void Reserve(size_t size);
+
+    /* Store the values and masks of the signature */
+    void Assign(const byte* values, const char* mask, size_t size);
+    void Assign(const byte* values, const byte* masks, size_t size);
+
+    /* Get the storage of the values and masks */
+    byte* GetMutableValues();
+    byte* GetMutableMasks();
+
+    /* Clear the masked out bits and prepare the vector layouts */
+    void PrepareVectors();
+
+    // Private members
+    size_t mSize;
+    size_t mAlignment;
+    size_t mAlignmentRemainder;
+
+    // The values and masks of signatures larger than <MaxVectorSize> bytes
+    std::vector<byte> mValues;
+    std::vector<byte> mMasks;
+
+    // The values and masks padded (with ignored bytes) to a vector size, at
+    // the start (forward) and at the end (backward) of the vector. The
+    // forward layout stores the signature when it fits.
+    byte mForwardValues[MaxVectorSize];
+    byte mForwardMasks[MaxVectorSize];
+    byte mBackwardValues[MaxVectorSize];
+    byte mBackwardMasks[MaxVectorSize];
+};
+
+inline size_t Signature::GetSize() const {
+  return mSize;
+}
+
+inline const byte* Signature::GetValues() const {
+  return (mSize > MaxVectorSize) ? mValues.data() : mForwardValues;
+}
+
+inline const byte* Signature::GetMasks() const {
+  return (mSize > MaxVectorSize) ? mMasks.data() : mForwardMasks;
+}
+
+inline size_t Signature::GetAlignment() const {
+  return mAlignment;
+}
+
+inline size_t Signature::GetAlignmentRemainder() const {
+  return mAlignmentRemainder;
+}
+
+inline bool Signature::IsAligned(const byte* data) const {
+  return mAlignment == 1 ||
+    (reinterpret_cast<size_t>(data) % mAlignment) == mAlignmentRemainder;
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
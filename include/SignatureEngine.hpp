@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ByteProfile.hpp"
+#include "RelocationMap.hpp"
+#include "ScanStatistics.hpp"
+#include "ShiftOr.hpp"
+#include "Signature.hpp"
+#include "Stride.hpp"
+
+/* Signature search engine
+ *
+ * Finds the matches of a single signature within memory blocks, using the
+ * search the scanner selects for it: aligned signatures are searched at
+ * eligible positions only, short signatures without a selective anchor
+ * bit-parallel, and every other signature by its rarest anchor. Relocated
+ * bytes can only be ignored by the anchor search. The selection is made
+ * once, on construction, so searching a block involves no further dispatch.
+ *
+ * Every search of the scanner selects its engine through this class. The
+ * selected engine is held in place, so constructing an engine does not
+ * allocate.
+ */
+class SignatureEngine {
+public:
+    /* Construct the search of a signature
+     *
+     * @signature The signature, which must outlive the engine.
+     *
+     * @profile The byte frequencies of the searched memory, or null for the
+     *          static profile (see <ByteProfile::GetStaticProfile>).
+     *
+     * @relocations An optional relocation map, whose relocated bytes are
+     *              treated as wildcards. It must outlive the engine.
+     */
+    explicit SignatureEngine(
+        const Signature& signature,
+        const ByteProfile* profile = nullptr,
+        const RelocationMap* relocations = nullptr);
+
+    /* Find the first match of the signature within a memory block
+     *
+     * @begin The start of the memory block.
+     *
+     * @end The end of the memory block (exclusive).
+     *
+     * @counters Optional counters of the candidates and verifications.
+     *
+     * @return The start of the first match, or null if none is found.
+     */
+    const byte* Find(
+        const byte* begin,
+        const byte* end,
+        ScanStatistics::Counters* counters = nullptr) const;
+
+    /* Get the signature searched for */
+    const Signature& GetSignature() const;
+
+private:
+    /* The search methods */
+    enum Method { AnchorMethod, ShiftOrMethod, StrideMethod };
+
+    // Private members
+    const Signature& mSignature;
+    const RelocationMap* mRelocations;
+    size_t mAnchorIndex;
+    size_t mAnchorLength;
+    Method mMethod;
+
+    // The engine of the method, if any (both are trivially destructible)
+    union {
+        ShiftOr mShiftOr;
+        Stride mStride;
+    };
+};
+
+inline const Signature& SignatureEngine::GetSignature() const {
+  return mSignature;
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
@@ -0,0 +1,165 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Resolver.hpp"
+#include "Signature.hpp"
+
+namespace {
+typedef unsigned char byte;
+}
+
+/* Signature pack
+ *
+ * A precompiled set of named signatures, with their alignments and
+ * resolvers, stored in a binary file. The file is mapped into memory
+ * (read-only) and used in place: the values and masks of a signature point
+ * into the mapping, so they can be searched for without being parsed or
+ * copied (see <SignatureScanner::FindSignature>). Signatures are updated by
+ * replacing the file, e.g one compiled with the 'packc' tool.
+ *
+ * The file starts with a magic, a format version and a checksum of its
+ * contents. Opening a pack only validates its header, signature records and
+ * resolver steps, so the values, masks and names are not read until they
+ * are used; the checksum is verified on demand (see <Verify>). Every value
+ * is stored in little endian byte order, and every field is aligned to eight
+ * bytes.
+ */
+class SignaturePack {
+public:
+    /* Signature pack exception */
+    class Exception : public std::runtime_error {
+    public:
+        explicit Exception(std::string error) : runtime_error(error.c_str()) {}
+    };
+
+    /* The version of the file format */
+    static const uint32_t Version = 1;
+
+    /* Maximum value for size_t, returned when a name is not found */
+    static const size_t npos = -1;
+
+    /* Open a pack file
+     *
+     * The file is mapped into memory. An <Exception> is thrown if it cannot
+     * be mapped, or if it is not a valid pack of the current <Version> (see
+     * <Verify> for its checksum).
+     *
+     * @path The path of the file.
+     */
+    explicit SignaturePack(const std::string& path);
+
+    /* Open a pack in memory
+     *
+     * An <Exception> is thrown if the memory is not a valid pack of the
+     * current <Version>.
+     *
+     * @data The start of the pack, which must outlive the pack (and every
+     *       copy of it).
+     *
+     * @size The size of the pack in bytes.
+     */
+    SignaturePack(const void* data, size_t size);
+
+    /* Verify the checksum of the pack
+     *
+     * Reads every byte of the pack (i.e faults in the whole mapping), thus
+     * it is not done when the pack is opened. Useful when the file may have
+     * been damaged, e.g after a download.
+     *
+     * @return True if the contents match the checksum, otherwise false.
+     */
+    bool Verify() const;
+
+    /* Get the number of signatures */
+    size_t GetCount() const;
+
+    /* Find the index of a signature by its name
+     *
+     * @name The name of the signature.
+     *
+     * @return The index of the first signature with the name, or <npos>.
+     */
+    size_t Find(const std::string& name) const;
+
+    /* Get the name of a signature (null-terminated) */
+    const char* GetName(size_t index) const;
+
+    /* Get the values of a signature, within the pack */
+    const byte* GetValues(size_t index) const;
+
+    /* Get the masks of a signature, within the pack */
+    const byte* GetMasks(size_t index) const;
+
+    /* Get the number of bytes in a signature */
+    size_t GetSize(size_t index) const;
+
+    /* Construct a signature, including its alignment
+     *
+     * @index The index of the signature.
+     *
+     * @return The signature.
+     */
+    Signature GetSignature(size_t index) const;
+
+    /* Construct the resolver of a signature
+     *
+     * @index The index of the signature.
+     *
+     * @return The resolver, which is empty if the signature has none.
+     */
+    Resolver GetResolver(size_t index) const;
+
+    /* Construct every signature, in order (see <GetSignature>) */
+    std::vector<Signature> GetSignatures() const;
+
+    /* Construct every resolver, in order (see <GetResolver>) */
+    std::vector<Resolver> GetResolvers() const;
+
+    /* Compile a pack
+     *
+     * The signatures keep their order, so the index of a signature in the
+     * pack equals its index in the vectors.
+     *
+     * @stream The (binary) output stream.
+     *
+     * @names The name of each signature.
+     *
+     * @signatures The signatures.
+     *
+     * @resolvers The resolver of each signature (may be empty).
+     *
+     * @return True if the pack was written, otherwise false.
+     */
+    static bool Save(
+        std::ostream& stream,
+        const std::vector<std::string>& names,
+        const std::vector<Signature>& signatures,
+        const std::vector<Resolver>& resolvers);
+
+private:
+    /* Validate the structure of the pack, throwing an <Exception> if it is
+     * invalid (the checksum is not verified) */
+    void Validate();
+
+    /* Get the record of a signature */
+    const byte* GetRecord(size_t index) const;
+
+    // Private members
+    std::shared_ptr<const void> mMapping;
+    const byte* mData;
+    size_t mSize;
+    size_t mCount;
+};
+
+inline size_t SignaturePack::GetCount() const {
+  return mCount;
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
@@ -1,9 +1,29 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
+#include <future>
 #include <stdexcept>
 #include <vector>
 #include <memory>
+#include <mutex>
+
+#include "ByteProfile.hpp"
+#include "CancellationToken.hpp"
+#include "FingerprintIndex.hpp"
+#include "FunctionIndex.hpp"
+#ifdef SCANNER_COROUTINES
+# include "Generator.hpp"
+#endif
+#include "Pattern.hpp"
+#include "RelocationMap.hpp"
+#include "ScanStatistics.hpp"
+#include "SelectivityReport.hpp"
+#include "Resolver.hpp"
+#include "ResultCache.hpp"
+#include "Signature.hpp"
+#include "Tracer.hpp"
+#include "VtableIndex.hpp"
 
 namespace {
 typedef unsigned char byte;
@@ -27,6 +47,45 @@ public:
         explicit Exception(std::string error) : runtime_error(error.c_str()) {}
     };
 
+    /* Thrown (through its future) when an asynchronous search is cancelled */
+    class CancelledException : public Exception {
+    public:
+        CancelledException() : Exception("the search was cancelled") {}
+    };
+
+    /* Executor of asynchronous searches
+     *
+     * Receives each search as a task, and runs it at some point on any
+     * thread (e.g by queueing it on a thread pool). An empty executor runs
+     * every search on a thread of its own.
+     */
+    typedef std::function<void(std::function<void()>)> Executor;
+
+    /* A list of address ranges, sorted in ascending order */
+    typedef std::vector<std::pair<uintptr_t, uintptr_t>> RegionList;
+
+    /* Reference flags
+     *
+     * The kinds of references that a reference search reports, combined
+     * with a bitwise or.
+     */
+    enum ReferenceFlags {
+        /* 32-bit relative operands (rel32 and RIP-relative addressing) */
+        RelativeReferences = 1 << 0,
+
+        /* Pointer sized absolute values */
+        AbsoluteReferences = 1 << 1,
+    };
+
+    /* String encodings */
+    enum StringEncoding {
+        /* Single byte characters (e.g ASCII or UTF-8) */
+        AsciiString,
+
+        /* Two byte, little endian, characters */
+        Utf16String,
+    };
+
     /* Construct a signature scanner
      *
      * Creates a signature scanner from an address located within a module.
@@ -45,9 +104,11 @@ public:
      * memory page and/or region that is read-protected will skipped in the
      * search. This includes regions that are page guarded on Windows.
      *
-     * The search is done by using simple pointer arithmetics. The comparison
-     * is done by using direct memory access of the processed region and the
-     * supplied byte signature.
+     * The search is driven by an anchor; the rarest non-wildcard byte, or pair
+     * of adjacent bytes, in the signature. Only positions where the anchor
+     * occurs are compared against the full signature. The rarity is decided
+     * by the module's byte profile if it has been computed (see
+     * <GetByteProfile>), otherwise by a static x86 profile.
      *
      * NOTE: The method does not throw an <Exception> when no result is found.
      *
@@ -67,6 +128,8 @@ public:
      * @length The maximum distance the search will be performed (counted in
      *         bytes). The length will be capped to the module size.
      *
+     * @flags A combination of <SearchFlags>.
+     *
      * @return The memory address of the first match of the signature,
      *         otherwise zero is returned (i.e null).
      */
@@ -74,7 +137,466 @@ public:
     	const std::vector<byte>& signature,
     	const char* mask,
     	size_t offset = 0,
-      size_t length = npos) const;
+      size_t length = npos,
+      uint flags = 0) const;
+
+    /* Search for a compiled signature
+     *
+     * Behaves like the byte mask variant, but supports bit level masks. A
+     * byte matches if '(data & mask) == value' (see <Signature>). Only bytes
+     * that are compared in their entirety are considered as anchors.
+     *
+     * The search does not allocate, apart from enumerating (and caching) the
+     * module's regions on first use, unless statistics are attached or the
+     * search is restricted to <FunctionStarts>.
+     *
+     * @signature The compiled signature.
+     *
+     * @offset The start offset for the search, relative to the module base.
+     *
+     * @length The maximum distance the search will be performed.
+     *
+     * @flags A combination of <SearchFlags>.
+     *
+     * @return The memory address of the first match of the signature,
+     *         otherwise zero is returned (i.e null).
+     */
+    uintptr_t FindSignature(
+        const Signature& signature,
+        size_t offset = 0,
+        size_t length = npos,
+        uint flags = 0) const;
+
+    /* Search for a signature described by pointers
+     *
+     * Behaves like the byte mask variant, but the values need not reside in
+     * a vector and the mask need not be null-terminated. Signatures of up to
+     * <Signature::MaxVectorSize> bytes are searched for without allocating
+     * (once the module's regions have been enumerated), like any compiled
+     * signature; see the compiled signature variant.
+     *
+     * @values A pointer to the byte values of the signature.
+     *
+     * @mask A character array of the same length as the values, where a
+     *       question mark character ignores the respective byte.
+     *
+     * @size The number of bytes in the signature.
+     *
+     * @offset The start offset for the search, relative to the module base.
+     *
+     * @length The maximum distance the search will be performed.
+     *
+     * @flags A combination of <SearchFlags>.
+     *
+     * @return The memory address of the first match of the signature,
+     *         otherwise zero is returned (i.e null).
+     */
+    uintptr_t FindSignature(
+        const byte* values,
+        const char* mask,
+        size_t size,
+        size_t offset = 0,
+        size_t length = npos,
+        uint flags = 0) const;
+
+    /* Search for a signature described by value and mask pointers
+     *
+     * Behaves like the pointer variant above, with bit level masks (see
+     * <Signature>).
+     */
+    uintptr_t FindSignature(
+        const byte* values,
+        const byte* masks,
+        size_t size,
+        size_t offset = 0,
+        size_t length = npos,
+        uint flags = 0) const;
+
+    /* Search for a signature described by a value pointer and mask bitmap
+     *
+     * Behaves like the pointer variant above, with one mask bit per byte;
+     * bit 'i % 64' of word 'i / 64' is set to include byte 'i'.
+     */
+    uintptr_t FindSignature(
+        const byte* values,
+        const uint64_t* bitmap,
+        size_t size,
+        size_t offset = 0,
+        size_t length = npos,
+        uint flags = 0) const;
+
+    /* Search for a signature and resolve the match
+     *
+     * The resolver is applied to every match, in ascending order, until one
+     * is successfully resolved. Reads performed by the resolver must lie
+     * within the accessible regions of the module, and the result must not
+     * be null, otherwise the match is considered unresolvable.
+     *
+     * @signature The compiled signature.
+     *
+     * @resolver The resolution program applied to each match.
+     *
+     * @offset The start offset for the search, relative to the module base.
+     *
+     * @length The maximum distance the search will be performed.
+     *
+     * @flags A combination of <SearchFlags>.
+     *
+     * @return The first resolved match, otherwise zero is returned.
+     */
+    uintptr_t FindSignature(
+        const Signature& signature,
+        const Resolver& resolver,
+        size_t offset = 0,
+        size_t length = npos,
+        uint flags = 0) const;
+
+    /* Search for several signatures at once
+     *
+     * The memory regions are only walked once, regardless of the number of
+     * signatures. The results correspond to the respective signature.
+     *
+     * @signatures The compiled signatures.
+     *
+     * @offset The start offset for the search, relative to the module base.
+     *
+     * @length The maximum distance the search will be performed.
+     *
+     * @flags A combination of <SearchFlags>.
+     *
+     * @return The first match of each signature, or zero if not found.
+     */
+    std::vector<uintptr_t> FindSignatures(
+        const std::vector<Signature>& signatures,
+        size_t offset = 0,
+        size_t length = npos,
+        uint flags = 0) const;
+
+    /* Search for several signatures at once and resolve the matches
+     *
+     * @signatures The compiled signatures.
+     *
+     * @resolvers The resolution programs, one for each signature. An empty
+     *            resolver leaves the match untouched.
+     *
+     * @offset The start offset for the search, relative to the module base.
+     *
+     * @length The maximum distance the search will be performed.
+     *
+     * @flags A combination of <SearchFlags>.
+     *
+     * @return The first resolved match of each signature, or zero.
+     */
+    std::vector<uintptr_t> FindSignatures(
+        const std::vector<Signature>& signatures,
+        const std::vector<Resolver>& resolvers,
+        size_t offset = 0,
+        size_t length = npos,
+        uint flags = 0) const;
+
+    /* Search for every match of a signature
+     *
+     * Matches may overlap each other.
+     *
+     * @signature The compiled signature.
+     *
+     * @offset The start offset for the search, relative to the module base.
+     *
+     * @length The maximum distance the search will be performed.
+     *
+     * @flags A combination of <SearchFlags>.
+     *
+     * @return Every match of the signature, in ascending order.
+     */
+    std::vector<uintptr_t> FindAllSignatures(
+        const Signature& signature,
+        size_t offset = 0,
+        size_t length = npos,
+        uint flags = 0) const;
+
+    /* Search for every match of a signature and resolve them
+     *
+     * Matches that cannot be resolved are omitted.
+     *
+     * @signature The compiled signature.
+     *
+     * @resolver The resolution program applied to each match.
+     *
+     * @offset The start offset for the search, relative to the module base.
+     *
+     * @length The maximum distance the search will be performed.
+     *
+     * @flags A combination of <SearchFlags>.
+     *
+     * @return Every resolved match, in ascending order of the matches.
+     */
+    std::vector<uintptr_t> FindAllSignatures(
+        const Signature& signature,
+        const Resolver& resolver,
+        size_t offset = 0,
+        size_t length = npos,
+        uint flags = 0) const;
+
+    /* Search for a signature within a function
+     *
+     * The function's bounds are retrieved from the module's function index
+     * (see <GetFunctionIndex>).
+     *
+     * @signature The compiled signature.
+     *
+     * @address Any address within the function.
+     *
+     * @flags A combination of <SearchFlags>.
+     *
+     * @return The address of the first match, otherwise zero is returned.
+     *         Zero is also returned if no function contains the address.
+     */
+    uintptr_t FindSignatureInFunction(
+        const Signature& signature,
+        uintptr_t address,
+        uint flags = 0) const;
+
+    /* Search for a signature asynchronously
+     *
+     * Behaves like <FindSignature>, but returns immediately. The search is
+     * run by the executor on a copy of the scanner, and its result (or
+     * exception) is delivered through the future. The token is checked
+     * before each memory region, and between chunks of large regions; once
+     * cancelled, the future receives a <CancelledException>.
+     *
+     * @signature The signature to search for.
+     *
+     * @token The token used to cancel the search.
+     *
+     * @executor The executor to run the search on.
+     *
+     * @offset The start offset for the search, relative to the module base.
+     *
+     * @length The maximum distance the search will be performed.
+     *
+     * @flags A combination of <SearchFlags>.
+     *
+     * @return The future first match, or zero if none is found.
+     */
+    std::future<uintptr_t> FindSignatureAsync(
+        const Signature& signature,
+        const CancellationToken& token = CancellationToken(),
+        const Executor& executor = Executor(),
+        size_t offset = 0,
+        size_t length = npos,
+        uint flags = 0) const;
+
+    /* Search for several signatures asynchronously
+     *
+     * Behaves like <FindSignatures>, see <FindSignatureAsync>.
+     *
+     * @return The future first match of each respective signature.
+     */
+    std::future<std::vector<uintptr_t>> FindSignaturesAsync(
+        const std::vector<Signature>& signatures,
+        const CancellationToken& token = CancellationToken(),
+        const Executor& executor = Executor(),
+        size_t offset = 0,
+        size_t length = npos,
+        uint flags = 0) const;
+
+    /* Search for every match of a signature asynchronously
+     *
+     * Behaves like <FindAllSignatures>, see <FindSignatureAsync>.
+     *
+     * @return The future matches, in ascending order.
+     */
+    std::future<std::vector<uintptr_t>> FindAllSignaturesAsync(
+        const Signature& signature,
+        const CancellationToken& token = CancellationToken(),
+        const Executor& executor = Executor(),
+        size_t offset = 0,
+        size_t length = npos,
+        uint flags = 0) const;
+
+#ifdef SCANNER_COROUTINES
+    /* Search for every match of a signature lazily
+     *
+     * Behaves like <FindAllSignatures>, but the search only proceeds as the
+     * consumer advances to the next match; stopping the iteration stops the
+     * search. The scanner must outlive the generator. This is only available
+     * when the library is built with 'SCANNER_COROUTINES' (C++20).
+     *
+     * @signature The signature to search for.
+     *
+     * @offset The start offset for the search, relative to the module base.
+     *
+     * @length The maximum distance the search will be performed.
+     *
+     * @flags A combination of <SearchFlags>.
+     *
+     * @return A generator of the matches, in ascending order.
+     */
+    Generator<uintptr_t> Matches(
+        Signature signature,
+        size_t offset = 0,
+        size_t length = npos,
+        uint flags = 0) const;
+#endif
+
+    /* Search for a pattern
+     *
+     * Tries to find a compiled <Pattern> within the constructed memory
+     * region. Regions are walked in the same manner as <FindSignature>, and a
+     * match never spans several regions.
+     *
+     * @pattern The compiled pattern.
+     *
+     * @offset The start offset for the search, relative to the module base.
+     *
+     * @length The maximum distance the search will be performed.
+     *
+     * @return The memory address of the first match of the pattern,
+     *         otherwise zero is returned (i.e null).
+     */
+    uintptr_t FindPattern(
+        const Pattern& pattern,
+        size_t offset = 0,
+        size_t length = npos) const;
+
+    /* Search for references to an address
+     *
+     * Finds every instruction within the executable regions of the module
+     * that refers to the target through a 32-bit relative operand; 'call',
+     * 'jmp' and 'jcc' with a rel32 operand, and instructions with
+     * RIP-relative addressing (e.g 'lea', 'mov'). The operand must be the
+     * last part of the instruction (i.e no trailing immediate).
+     *
+     * The operands are compared using vector instructions, computing the
+     * destination of every possible operand position in the module.
+     *
+     * Absolute references (pointer sized values equal to the target) are
+     * included if requested. Those that belong to a 'movabs' report the
+     * instruction, others report the address of the value.
+     *
+     * @target The referenced address.
+     *
+     * @offset The start offset for the search, relative to the module base.
+     *
+     * @length The maximum distance the search will be performed.
+     *
+     * @referenceFlags A combination of <ReferenceFlags>.
+     *
+     * @return The addresses of the referencing instructions, in ascending
+     *         order.
+     */
+    std::vector<uintptr_t> FindReferences(
+        uintptr_t target,
+        size_t offset = 0,
+        size_t length = npos,
+        uint referenceFlags = RelativeReferences) const;
+
+    /* Search for references to several addresses at once
+     *
+     * Behaves like the single target variant, but the module is only walked
+     * once. Operands are first filtered by the range spanned by the targets,
+     * and then looked up among the targets.
+     *
+     * @targets The referenced addresses.
+     *
+     * @offset The start offset for the search, relative to the module base.
+     *
+     * @length The maximum distance the search will be performed.
+     *
+     * @referenceFlags A combination of <ReferenceFlags>.
+     *
+     * @return The referencing instructions of each respective target.
+     */
+    std::vector<std::vector<uintptr_t>> FindReferences(
+        const std::vector<uintptr_t>& targets,
+        size_t offset = 0,
+        size_t length = npos,
+        uint referenceFlags = RelativeReferences) const;
+
+    /* Search for pointers into an address range
+     *
+     * Finds every pointer sized, naturally aligned, slot within the module
+     * whose value lies within the range (e.g virtual pointers, back
+     * references to heap objects). The slots are compared several at a time
+     * using vector instructions, if available.
+     *
+     * @lower The lower bound of the range (inclusive).
+     *
+     * @upper The upper bound of the range (exclusive).
+     *
+     * @offset The start offset for the search, relative to the module base.
+     *
+     * @length The maximum distance the search will be performed.
+     *
+     * @regionFlags A combination of <RegionFlags> (e.g <WritableRegion>).
+     *
+     * @return The addresses of the slots, in ascending order.
+     */
+    std::vector<uintptr_t> FindPointers(
+        uintptr_t lower,
+        uintptr_t upper,
+        size_t offset = 0,
+        size_t length = npos,
+        uint regionFlags = 0) const;
+
+    /* Search for pointers into an address range, outside the module
+     *
+     * Like the module search (see above), but walks address ranges supplied
+     * by the caller instead, e.g heap blocks, the regions of other modules,
+     * or every mapping of the process. Each range is walked with the same
+     * region filters, so inaccessible parts are skipped, but the whole range
+     * must be mapped; otherwise an <Exception> is thrown.
+     *
+     * @lower The lower bound of the value range (inclusive).
+     *
+     * @upper The upper bound of the value range (exclusive).
+     *
+     * @ranges The address ranges to search, in ascending order.
+     *
+     * @regionFlags A combination of <RegionFlags> (e.g <WritableRegion>).
+     *
+     * @return The addresses of the slots, in ascending order.
+     */
+    std::vector<uintptr_t> FindPointers(
+        uintptr_t lower,
+        uintptr_t upper,
+        const RegionList& ranges,
+        uint regionFlags = 0) const;
+
+    /* Search for a string literal
+     *
+     * Tries to find a null-terminated string within the read-only regions of
+     * the module. The string may be the suffix of a longer string, since
+     * compilers merge literals with common tails.
+     *
+     * @text The string to find, excluding the null terminator. For UTF-16,
+     *       each (ASCII) character is widened to two bytes.
+     *
+     * @encoding The encoding of the string in memory.
+     *
+     * @return The address of the first occurrence, otherwise zero.
+     */
+    uintptr_t FindString(
+        const std::string& text,
+        StringEncoding encoding = AsciiString) const;
+
+    /* Search for the code that refers to a string literal
+     *
+     * Every occurrence of the string within the read-only regions is located
+     * (see <FindString>), after which the executable regions are searched for
+     * relative and absolute references to any of them in a single pass (see
+     * <FindReferences>).
+     *
+     * @text The string to find, excluding the null terminator.
+     *
+     * @encoding The encoding of the string in memory.
+     *
+     * @return The addresses of the referencing instructions, in ascending
+     *         order.
+     */
+    std::vector<uintptr_t> FindStringReferences(
+        const std::string& text,
+        StringEncoding encoding = AsciiString) const;
 
     /* Search for a module symbol
      *
@@ -88,6 +610,112 @@ public:
      */
     void* FindSymbol(const std::string& symbol) const;
 
+    /* Search for the virtual table of a class
+     *
+     * Looks up the primary virtual table of a polymorphic class in the
+     * module's virtual table index (see <GetVtableIndex>). This works for
+     * classes without exported symbols, but requires RTTI.
+     *
+     * @className The qualified (e.g 'ns::Foo') or mangled (e.g 'N2ns3FooE')
+     *            name of the class.
+     *
+     * @return The address point of the virtual table (i.e the value of an
+     *         object's virtual pointer), otherwise zero is returned.
+     */
+    uintptr_t FindVtable(const std::string& className) const;
+
+    /* Search for a function by its fingerprint
+     *
+     * Looks up the first function with the fingerprint in the module's
+     * fingerprint index (see <GetFingerprintIndex>).
+     *
+     * @fingerprint The hash of the function's normalized bytes.
+     *
+     * @return The start of the function, otherwise zero is returned.
+     */
+    uintptr_t FindFunction(uint64_t fingerprint) const;
+
+    /* Get the byte profile of the module
+     *
+     * The profile is computed on first use, by reading every accessible
+     * region of the module, and is cached for the lifetime of the scanner
+     * (and its copies). All searches performed after the profile has been
+     * computed use it to select their anchors.
+     *
+     * @return The byte frequency profile of the module.
+     */
+    const ByteProfile& GetByteProfile() const;
+
+    /* Get the relocation map of the module
+     *
+     * The map is built on first use from the module's dynamic relocation
+     * tables ('.rela.dyn', '.rel.dyn', PLT and packed relative relocations on
+     * Linux, base relocations on Windows), as they reside in memory. It is
+     * cached for the lifetime of the scanner (and its copies). If the tables
+     * cannot be located an <Exception> is thrown.
+     *
+     * @return The relocation map of the module.
+     */
+    const RelocationMap& GetRelocationMap() const;
+
+    /* Get the virtual table index of the module
+     *
+     * The index is built on first use by scanning the module's read-only
+     * data after relocation ('.data.rel.ro', covered by the 'PT_GNU_RELRO'
+     * segment) for Itanium ABI virtual tables; an offset-to-top followed by
+     * a type information pointer, and a run of pointers into the module's
+     * code. The type information must point to a valid mangled name, or be
+     * null (without RTTI, in which case the table is unnamed). The index is
+     * cached for the lifetime of the scanner (and its copies). On Windows,
+     * or if the module headers cannot be located, an <Exception> is thrown.
+     *
+     * @return The virtual table index of the module.
+     */
+    const VtableIndex& GetVtableIndex() const;
+
+    /* Get the function index of the module
+     *
+     * The index is built on first use from the module's unwind information
+     * as it resides in memory; the binary search table of '.eh_frame_hdr'
+     * (the 'PT_GNU_EH_FRAME' segment) and the frame description entries it
+     * refers to on Linux, and the '.pdata' function table on Windows (x64).
+     * Functions without unwind information are not indexed. The index is
+     * cached for the lifetime of the scanner (and its copies). If the module
+     * headers cannot be located an <Exception> is thrown.
+     *
+     * @return The function index of the module.
+     */
+    const FunctionIndex& GetFunctionIndex() const;
+
+    /* Get the fingerprint index of the module
+     *
+     * The index is built on first use by fingerprinting every function of
+     * the function index (see <GetFunctionIndex>). Relocated bytes, and the
+     * relative operands of 'call', 'jmp', 'jcc' and RIP-relative
+     * instructions referring to the module, are normalized. The index is
+     * cached for the lifetime of the scanner (and its copies).
+     *
+     * If a directory is supplied (and the module has a build ID), the index
+     * is persisted as '<directory>/<build ID>.fingerprints'; an existing
+     * index is read instead of being built, otherwise the built index is
+     * written. Failures to write the index are ignored.
+     *
+     * @directory The directory of persisted indexes, or empty for none.
+     *
+     * @return The fingerprint index of the module.
+     */
+    const FingerprintIndex& GetFingerprintIndex(
+        const std::string& directory = std::string()) const;
+
+    /* Get the build ID of the module
+     *
+     * The GNU build ID note ('NT_GNU_BUILD_ID') on Linux, and the CodeView
+     * debug information (PDB GUID and age) on Windows.
+     *
+     * @return The build ID as a hex string, or empty if there is none.
+     */
+    std::string GetBuildId() const;
+
     /* Get the base address of the module
      *
      * @return The base address of the module.
@@ -100,6 +728,77 @@ public:
      */
     size_t GetModuleSize() const;
 
+    /* Get the searchable regions of the module
+     *
+     * The accessible regions that every search walks (i.e not merged),
+     * enumerated on first use and cached.
+     *
+     * @return The accessible regions of the module.
+     */
+    std::shared_ptr<const RegionList> GetSearchableRegions() const;
+
+    /* Attach statistics to the scanner
+     *
+     * Every signature search made by the scanner (and its copies made
+     * afterwards) is recorded; the counters are accumulated and the latency
+     * of the search is added to each of its signatures. In a batch search,
+     * each signature is only charged the time spent searching for it, and
+     * its share of the prefilter passes that cover it. The counters of the
+     * last search on a thread are available through
+     * <ScanStatistics::GetLastScan>. Counting is disabled when no statistics
+     * are attached (the default).
+     *
+     * @statistics The statistics to record into, or null to detach them.
+     */
+    void SetStatistics(std::shared_ptr<ScanStatistics> statistics);
+
+    /* Get the attached statistics, if any */
+    std::shared_ptr<ScanStatistics> GetStatistics() const;
+
+    /* Attach a shared result cache to the scanner
+     *
+     * Single signature searches (see <FindSignature>) made by the scanner
+     * (and its copies made afterwards) are looked up in the cache, and
+     * stored in it on a miss. Results are keyed by the module's build ID
+     * (see <GetBuildId>), the signature, its resolver and the search
+     * parameters, so every process loading the same build shares them.
+     * Results outside of the module (e.g resolved heap pointers) are not
+     * cached, nor are the results of modules without a build ID, searches
+     * whose resolver dereferences memory or failed resolved searches. No
+     * cache is attached by default.
+     *
+     * @cache The cache to use, or null to detach it.
+     */
+    void SetResultCache(std::shared_ptr<ResultCache> cache);
+
+    /* Get the attached result cache, if any */
+    std::shared_ptr<ResultCache> GetResultCache() const;
+
+    /* Profile the selectivity of signatures
+     *
+     * Searches for every match of each signature in turn, while counting
+     * anchor occurrences and the byte at which each failed verification
+     * diverged, and timing each signature. The anchors are those that a
+     * search would use at the time of the call. Suggestions are based on the
+     * module's byte profile, which is computed (and cached) if necessary.
+     * This is considerably slower than a regular search.
+     *
+     * @signatures The signatures to profile.
+     *
+     * @offset The start offset for the search, relative to the module base.
+     *
+     * @length The maximum distance the search will be performed.
+     *
+     * @flags A combination of <SearchFlags>.
+     *
+     * @return The report of each respective signature.
+     */
+    std::vector<SelectivityReport> ProfileSignatures(
+        const std::vector<Signature>& signatures,
+        size_t offset = 0,
+        size_t length = npos,
+        uint flags = 0) const;
+
 public:
     /* Maximum value for size_t
      *
@@ -108,7 +807,40 @@ public:
      */
     static const size_t npos = -1;
 
+    /* Search flags
+     *
+     * Flags that alter the behavior of a search, combined with a bitwise or.
+     */
+    enum SearchFlags {
+        /* Treat bytes that are patched by the dynamic loader as wildcards.
+         * The relocation map is built on first use (see <GetRelocationMap>). */
+        IgnoreRelocations = 1 << 0,
+
+        /* Only match at the start of a function (see <GetFunctionIndex>).
+         * Each function start is compared instead of every position. */
+        FunctionStarts = 1 << 1,
+    };
+
+    /* Region flags
+     *
+     * Requirements that a memory region must fulfill to be searched, combined
+     * with a bitwise or. Readability is always required.
+     */
+    enum RegionFlags {
+        /* The region must be executable */
+        ExecutableRegion = 1 << 0,
+
+        /* The region must be writable */
+        WritableRegion = 1 << 1,
+
+        /* The region must not be writable */
+        ReadOnlyRegion = 1 << 2,
+    };
+
 private:
+    // Searches the module like the scanner does (see <BasicScanner>)
+    friend class ModuleSource;
+
     /* Describes a region of memory
      *
      * The base address is not necessarily a base address of a module,
@@ -168,8 +900,207 @@ private:
      */
     bool IsMemoryAccessible(const MemoryInformation& memoryInfo) const;
 
+    /* Check if a memory region fulfills a set of requirements
+     *
+     * @memoryInfo A memory information object describing the protection flags
+     *             of the region of interest.
+     *
+     * @regionFlags A combination of <RegionFlags>.
+     *
+     * @return True if the memory is accessible and fulfills the requirements.
+     */
+    bool IsMemoryEligible(const MemoryInformation& memoryInfo, uint regionFlags) const;
+
+    /* Load the module's relocations
+     *
+     * Parses the relocation tables of the module, as mapped in memory, and
+     * marks every relocated field. If the tables cannot be located an
+     * <Exception> is thrown.
+     *
+     * @relocations The relocation map to populate.
+     */
+    void LoadRelocations(RelocationMap* relocations) const;
+
+    /* Load the module's virtual tables
+     *
+     * @vtables The virtual table index to populate.
+     */
+    void LoadVtables(VtableIndex* vtables) const;
+
+    /* Load the module's functions
+     *
+     * @functions The function index to populate.
+     */
+    void LoadFunctions(FunctionIndex* functions) const;
+
+    /* Load the fingerprints of the module's functions
+     *
+     * @fingerprints The fingerprint index to populate.
+     */
+    void LoadFingerprints(FingerprintIndex* fingerprints) const;
+
+    /* Iterate over the accessible regions of an address range
+     *
+     * The callback is invoked with the bounds of each accessible region,
+     * clamped to the range, in ascending order. Inaccessible regions, and
+     * regions that do not fulfill the region flags, are skipped. The
+     * iteration stops when the callback returns false.
+     *
+     * @start The lower bound of the range (inclusive).
+     *
+     * @end The upper bound of the range (exclusive).
+     *
+     * @callback A callable with the signature 'bool(const byte*, const byte*)'.
+     *
+     * @regionFlags A combination of <RegionFlags>.
+     *
+     * @counters Optional counters of visited and skipped regions.
+     */
+    template<typename Callback>
+    void ForEachRegion(
+        uintptr_t start,
+        uintptr_t end,
+        Callback callback,
+        uint regionFlags = 0,
+        ScanStatistics::Counters* counters = nullptr) const;
+
+    /* Iterate over the (resolved) matches of several signatures
+     *
+     * Each region is searched for every signature that passes the filter,
+     * before proceeding to the next region. Matches that cannot be resolved
+     * are skipped. The iteration stops when the callback returns false.
+     *
+     * @callback A callable with the signature 'bool(size_t, uintptr_t)',
+     *           receiving the signature index and the (resolved) match.
+     *
+     * @filter A callable with the signature 'bool(size_t)', returning
+     *         whether the signature at an index should still be searched for.
+     *
+     * @regionFlags A combination of <RegionFlags>.
+     *
+     * @token An optional token, checked before each chunk of a region. A
+     *        <CancelledException> is thrown once it has been cancelled.
+     */
+    template<typename Callback, typename Filter>
+    void ForEachMatch(
+        const std::vector<Signature>& signatures,
+        const std::vector<Resolver>& resolvers,
+        size_t offset,
+        size_t length,
+        uint flags,
+        Callback callback,
+        Filter filter,
+        uint regionFlags = 0,
+        const CancellationToken* token = nullptr) const;
+
+    /* Search for the first match of a signature without allocating
+     *
+     * Implements <FindSignature> for compiled signatures, using the cached
+     * regions of the module (see <GetSearchableRegions>).
+     */
+    uintptr_t FindFirstMatch(
+        const Signature& signature,
+        size_t offset,
+        size_t length,
+        uint flags) const;
+
+    /* Search for the first (resolved) match of a signature, through the
+     * attached result cache (see <SetResultCache>)
+     *
+     * @resolver The resolver of the signature, or null for none.
+     *
+     * @search A callable with the signature 'uintptr_t()', performing the
+     *         search if the result is not cached.
+     */
+    template<typename Search>
+    uintptr_t FindCachedMatch(
+        const Signature& signature,
+        const Resolver* resolver,
+        size_t offset,
+        size_t length,
+        uint flags,
+        Search search) const;
+
+    /* Search for the first (resolved) match of several signatures
+     *
+     * Implements <FindSignatures>, optionally observing a token.
+     */
+    std::vector<uintptr_t> FindFirstMatches(
+        const std::vector<Signature>& signatures,
+        const std::vector<Resolver>& resolvers,
+        size_t offset,
+        size_t length,
+        uint flags,
+        const CancellationToken* token) const;
+
+    /* Search for every (resolved) match of a signature
+     *
+     * Implements <FindAllSignatures>, optionally observing a token.
+     */
+    std::vector<uintptr_t> FindEveryMatch(
+        const Signature& signature,
+        const Resolver& resolver,
+        size_t offset,
+        size_t length,
+        uint flags,
+        const CancellationToken* token) const;
+
+    /* Run a search on an executor
+     *
+     * @executor The executor, or empty for a thread of its own.
+     *
+     * @search A callable returning the result, or throwing an exception.
+     *
+     * @return The future result of the search.
+     */
+    template<typename Result, typename Search>
+    std::future<Result> RunAsync(const Executor& executor, Search search) const;
+
+    /* Get the accessible regions of the module
+     *
+     * The regions are enumerated on first use and cached. Adjacent regions
+     * are merged into a single range.
+     *
+     * @return The accessible address ranges of the module.
+     */
+    std::shared_ptr<const RegionList> GetAccessibleRegions() const;
+
+    /* Get the module's byte profile if it has been computed, otherwise null */
+    std::shared_ptr<const ByteProfile> GetCachedByteProfile() const;
+
+    /* Resolve a match, only permitting reads within the module
+     *
+     * @resolver The resolution program.
+     *
+     * @match The match to resolve.
+     *
+     * @result A pointer receiving the resolved (non-null) address.
+     *
+     * @return True if the match was resolved, otherwise false.
+     */
+    bool Resolve(const Resolver& resolver, uintptr_t match, uintptr_t* result) const;
+
+    /* Lazily computed module information
+     *
+     * Shared between copies of a scanner, since they describe the same module.
+     */
+    struct ModuleCache {
+        std::mutex mutex;
+        std::shared_ptr<const ByteProfile> profile;
+        std::shared_ptr<const RelocationMap> relocations;
+        std::shared_ptr<const RegionList> regions;
+        std::shared_ptr<const RegionList> searchable;
+        std::shared_ptr<const VtableIndex> vtables;
+        std::shared_ptr<const FunctionIndex> functions;
+        std::shared_ptr<const FingerprintIndex> fingerprints;
+        std::shared_ptr<const std::string> buildId;
+    };
+
     // Private members
+    std::shared_ptr<ModuleCache> mCache;
     std::shared_ptr<void> mModuleHandle;
+    std::shared_ptr<ScanStatistics> mStatistics;
+    std::shared_ptr<ResultCache> mResultCache;
     uintptr_t mBaseAddress;
     size_t mModuleSize;
 };
@@ -182,4 +1113,20 @@ inline size_t SignatureScanner::GetModuleSize() const {
   return mModuleSize;
 }
 
+inline void SignatureScanner::SetStatistics(std::shared_ptr<ScanStatistics> statistics) {
+  mStatistics = statistics;
+}
+
+inline std::shared_ptr<ScanStatistics> SignatureScanner::GetStatistics() const {
+  return mStatistics;
+}
+
+inline void SignatureScanner::SetResultCache(std::shared_ptr<ResultCache> cache) {
+  mResultCache = cache;
+}
+
+inline std::shared_ptr<ResultCache> SignatureScanner::GetResultCache() const {
+  return mResultCache;
+}
+
 /* vim: set ts=2 sw=2 expandtab: */
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ScanStatistics.hpp"
+#include "Signature.hpp"
+
+/* Aligned (strided) signature search
+ *
+ * Only tests the positions that are eligible for an aligned signature (see
+ * <Signature::SetAlignment>), stepping by the alignment. Each position is
+ * filtered by a four byte window of the signature (the one comparing the
+ * most bits) before it is verified. With AVX2, the windows of eight
+ * consecutive positions are gathered and compared at once.
+ */
+class Stride {
+public:
+    /* Construct the search of a signature
+     *
+     * @signature An aligned signature, which must outlive the search.
+     */
+    explicit Stride(const Signature& signature);
+
+    /* Find the first match of the signature within a memory block
+     *
+     * @begin The start of the memory block.
+     *
+     * @end The end of the memory block (exclusive).
+     *
+     * @counters Optional counters of the candidates and verifications.
+     *
+     * @return The start of the first match, or null if none is found.
+     */
+    const byte* Find(
+        const byte* begin,
+        const byte* end,
+        ScanStatistics::Counters* counters = nullptr) const;
+
+private:
+    /* Read the window of a position */
+    uint32_t ReadWindow(const byte* position) const;
+
+    // Private members
+    const Signature& mSignature;
+    size_t mWindowOffset;
+    size_t mWindowLength;
+    uint32_t mWindowValue;
+    uint32_t mWindowMask;
+};
+
+/* vim: set ts=2 sw=2 expandtab: */
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+/* Scan tracer
+ *
+ * An opt-in recorder of timed scan phases (module sizing, region lookups,
+ * region and chunk searches), for inspection in a trace viewer such as
+ * 'chrome://tracing' or Perfetto. Each thread records into a ring buffer of
+ * its own without locking; once full, the oldest events are overwritten.
+ * The buffer of an exited thread is reused by a new thread once its events
+ * have been written or cleared. While disabled, a phase costs a single
+ * relaxed load.
+ */
+class Tracer {
+public:
+    /* The default number of events retained per thread */
+    static const size_t DefaultCapacity = 1 << 16;
+
+    /* Records the duration of a phase, from construction to destruction */
+    class Scope {
+    public:
+        /* Begin a phase
+         *
+         * @name A string literal naming the phase.
+         *
+         * @argument A value shown alongside the phase (e.g a size).
+         */
+        explicit Scope(const char* name, uint64_t argument = 0);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        // Private members
+        const char* mName;
+        uint64_t mArgument;
+        uint64_t mStart;
+        bool mActive;
+    };
+
+    /* Start recording events
+     *
+     * @capacity The number of events retained per thread, for threads that
+     *           have not recorded any events yet.
+     */
+    static void Enable(size_t capacity = DefaultCapacity);
+
+    /* Stop recording events (recorded events are retained) */
+    static void Disable();
+
+    /* Check if events are being recorded */
+    static bool IsEnabled();
+
+    /* Discard every event recorded so far */
+    static void Clear();
+
+    /* Record a completed phase
+     *
+     * @name A string literal naming the phase.
+     *
+     * @start The start of the phase (see <GetTimestamp>).
+     *
+     * @duration The duration of the phase in nanoseconds.
+     *
+     * @argument A value shown alongside the phase.
+     */
+    static void Record(const char* name, uint64_t start, uint64_t duration, uint64_t argument);
+
+    /* Get the number of per-thread buffers currently allocated
+     *
+     * Includes the retained buffers of exited threads, whose events have
+     * not yet been written or cleared.
+     */
+    static size_t GetBufferCount();
+
+    /* Get the current time, in nanoseconds since an arbitrary epoch */
+    static uint64_t GetTimestamp();
+
+    /* Write the recorded events in the Chrome trace event format (JSON)
+     *
+     * May be called while other threads are recording.
+     *
+     * @stream The stream to write to.
+     */
+    static void WriteChromeTrace(std::ostream& stream);
+
+private:
+    // Private members
+    static std::atomic<bool> mEnabled;
+};
+
+inline bool Tracer::IsEnabled() {
+  return mEnabled.load(std::memory_order_relaxed);
+}
+
+inline Tracer::Scope::Scope(const char* name, uint64_t argument) :
+    mName(name),
+    mArgument(argument),
+    mStart(0),
+    mActive(Tracer::IsEnabled())
+{
+  if(mActive) {
+    mStart = Tracer::GetTimestamp();
+  }
+}
+
+inline Tracer::Scope::~Scope() {
+  if(mActive) {
+    Tracer::Record(mName, mStart, Tracer::GetTimestamp() - mStart, mArgument);
+  }
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Virtual table index
+ *
+ * An index of the C++ virtual tables (Itanium ABI) within a module, keyed by
+ * the mangled name of their class as stored in the class's type information
+ * (e.g '3Foo' or 'N2ns3FooE'). A class with multiple (non-virtual) bases has
+ * several virtual tables that share the same type information; the primary
+ * table is the one with an offset-to-top of zero.
+ */
+class VtableIndex {
+public:
+    /* Describes a virtual table */
+    struct Vtable {
+        /* The address point, i.e the first virtual function slot. This is the
+         * value stored in the virtual pointer of an object. */
+        uintptr_t address;
+
+        /* The offset from the sub-object to the top of the complete object */
+        ptrdiff_t offsetToTop;
+
+        /* The address of the type information, or zero without RTTI */
+        uintptr_t typeInfo;
+
+        /* The number of consecutive function pointers */
+        size_t functionCount;
+
+        /* The mangled class name, or empty without RTTI */
+        std::string name;
+    };
+
+    /* Add a virtual table to the index
+     *
+     * @vtable The virtual table to add.
+     */
+    void Add(const Vtable& vtable);
+
+    /* Find the primary virtual table of a class
+     *
+     * @name The mangled class name.
+     *
+     * @return A pointer to the virtual table, otherwise null.
+     */
+    const Vtable* Find(const std::string& name) const;
+
+    /* Find every virtual table of a class (primary and secondary)
+     *
+     * @name The mangled class name.
+     *
+     * @return Pointers to the virtual tables, in ascending order.
+     */
+    std::vector<const Vtable*> FindAll(const std::string& name) const;
+
+    /* Get every indexed virtual table, in ascending order */
+    const std::vector<Vtable>& GetVtables() const;
+
+    /* Mangle a qualified class name
+     *
+     * Converts a plain (non-template) name such as 'ns::Foo' into its
+     * mangled form, 'N2ns3FooE'. Names that are already mangled (i.e start
+     * with a digit or 'N') are returned unchanged.
+     *
+     * @name The qualified class name.
+     *
+     * @return The mangled class name.
+     */
+    static std::string MangleName(const std::string& name);
+
+private:
+    // Private members
+    std::vector<Vtable> mVtables;
+    std::unordered_multimap<std::string, size_t> mNames;
+};
+
+inline const std::vector<VtableIndex::Vtable>& VtableIndex::GetVtables() const {
+  return mVtables;
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
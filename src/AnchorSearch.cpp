@@ -0,0 +1,198 @@
+#include <cstring>
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
+
+#include "AnchorSearch.hpp"
+#include "Bits.hpp"
+
+AnchorSearch::Anchor AnchorSearch::SelectAnchor(
+    const Signature& signature,
+    const ByteProfile& profile) {
+  const byte* values = signature.GetValues();
+  const byte* masks = signature.GetMasks();
+
+  Anchor anchor = { 0, 0, 1.0 };
+  double rarest = 2.0;
+
+  // Only bytes that are compared in their entirety can be searched for
+  for(size_t i = 0; i < signature.GetSize(); i++) {
+    if(masks[i] != 0xFF) {
+      continue;
+    }
+
+    double frequency = profile.GetByteFrequency(values[i]);
+    if(frequency < rarest) {
+      anchor = { i, 1, frequency };
+      rarest = frequency;
+    }
+
+    if((i + 1) < signature.GetSize() && masks[i + 1] == 0xFF) {
+      frequency = profile.GetPairFrequency(values[i], values[i + 1]);
+
+      if(frequency < rarest) {
+        anchor = { i, 2, frequency };
+        rarest = frequency;
+      }
+    }
+  }
+
+  return anchor;
+}
+
+const byte* AnchorSearch::FindAnchor(
+    const byte* begin,
+    const byte* end,
+    const byte* anchor,
+    size_t length) {
+  if(begin >= end) {
+    return nullptr;
+  }
+
+  if(length == 1) {
+    return static_cast<const byte*>(memchr(begin, anchor[0], end - begin));
+  }
+
+#ifdef __SSE2__
+  const __m128i first = _mm_set1_epi8(static_cast<char>(anchor[0]));
+  const __m128i second = _mm_set1_epi8(static_cast<char>(anchor[1]));
+
+  for(; (end - begin) > 16; begin += 16) {
+    const __m128i lower = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+    const __m128i upper = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin + 1));
+
+    int matches = _mm_movemask_epi8(_mm_and_si128(
+      _mm_cmpeq_epi8(lower, first),
+      _mm_cmpeq_epi8(upper, second)));
+
+    if(matches != 0) {
+      return begin + Bits::CountTrailingZeros(static_cast<uint32_t>(matches));
+    }
+  }
+#endif
+
+  for(; (begin + 1) < end; begin++) {
+    if(begin[0] == anchor[0] && begin[1] == anchor[1]) {
+      return begin;
+    }
+  }
+
+  return nullptr;
+}
+
+bool AnchorSearch::MatchesRelocated(
+    const byte* data,
+    const Signature& signature,
+    const RelocationMap& relocations) {
+  if(signature.Matches(data)) {
+    return true;
+  }
+
+  const byte* values = signature.GetValues();
+  const byte* masks = signature.GetMasks();
+
+  for(size_t x = 0; x < signature.GetSize(); x++) {
+    if((data[x] & masks[x]) != values[x] &&
+        !relocations.IsRelocated(reinterpret_cast<uintptr_t>(data + x))) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+const byte* AnchorSearch::FindInBlock(
+    const byte* begin,
+    const byte* end,
+    const Signature& signature,
+    const Anchor& anchor,
+    const RelocationMap* relocations,
+    ScanStatistics::Counters* counters /*= nullptr*/) {
+  const size_t size = signature.GetSize();
+
+  if(static_cast<size_t>(end - begin) < size) {
+    return nullptr;
+  }
+
+  auto matches = [&](const byte* candidate) {
+    if(!signature.IsAligned(candidate)) {
+      return false;
+    }
+
+    if(counters != nullptr) {
+      counters->verifications++;
+    }
+
+    return relocations ?
+      MatchesRelocated(candidate, signature, *relocations) :
+      signature.Matches(candidate);
+  };
+
+  // Signatures without any complete bytes must be compared everywhere
+  if(anchor.length == 0) {
+    for(const byte* candidate = begin; candidate <= (end - size); candidate++) {
+      if(matches(candidate)) {
+        return candidate;
+      }
+    }
+
+    return nullptr;
+  }
+
+  // The anchor may not be located past the last possible match
+  const byte* limit = end - size + anchor.index + anchor.length;
+  const byte* values = signature.GetValues() + anchor.index;
+  const byte* result = nullptr;
+
+  for(const byte* position = begin + anchor.index;; position++) {
+    position = FindAnchor(position, limit, values, anchor.length);
+
+    if(position == nullptr) {
+      break;
+    }
+
+    if(counters != nullptr) {
+      counters->candidates++;
+    }
+
+    const byte* candidate = position - anchor.index;
+    if(matches(candidate)) {
+      result = candidate;
+      break;
+    }
+  }
+
+  if(relocations == nullptr) {
+    return result;
+  }
+
+  // Candidates whose anchor overlaps a relocated byte are invisible to the
+  // anchor search, so they are enumerated from the relocation map instead.
+  const uintptr_t lower = reinterpret_cast<uintptr_t>(begin + anchor.index);
+  const uintptr_t upper = reinterpret_cast<uintptr_t>(result ?
+    result + anchor.index + anchor.length : limit);
+
+  for(uintptr_t relocated = relocations->FindNext(lower, upper);
+      relocated != 0;
+      relocated = relocations->FindNext(relocated + 1, upper)) {
+    for(size_t x = anchor.length; x-- > 0;) {
+      const byte* candidate = reinterpret_cast<const byte*>(relocated) - anchor.index - x;
+
+      if(candidate < begin || candidate > (end - size)) {
+        continue;
+      }
+
+      if(result != nullptr && candidate >= result) {
+        return result;
+      }
+
+      if(matches(candidate)) {
+        return candidate;
+      }
+    }
+  }
+
+  return result;
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
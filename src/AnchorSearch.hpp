@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "ByteProfile.hpp"
+#include "RelocationMap.hpp"
+#include "ScanStatistics.hpp"
+#include "Signature.hpp"
+
+/* Anchored signature search
+ *
+ * Finds the occurrences of a signature's rarest one or two byte part (its
+ * anchor) and verifies the signature around each of them. This is the
+ * general search; the bit-parallel and strided searches are preferred for
+ * the signatures they suit.
+ */
+namespace AnchorSearch {
+/* The anchor frequency from which a bit-parallel search is preferred */
+const double ShiftOrThreshold = 1.0 / 64;
+
+/* The part of a signature used as candidate filter */
+struct Anchor {
+  size_t index;
+  size_t length;
+  double frequency;
+};
+
+/* Select the rarest anchor of a signature
+ *
+ * Only bytes that are compared in their entirety are considered. A signature
+ * without any yields an anchor with a length of zero.
+ *
+ * @signature The signature.
+ *
+ * @profile The byte frequencies of the searched memory.
+ *
+ * @return The anchor.
+ */
+Anchor SelectAnchor(const Signature& signature, const ByteProfile& profile);
+
+/* Find the first occurrence of a one or two byte anchor
+ *
+ * The anchor must reside completely within [begin, end).
+ *
+ * @return A pointer to the first anchor byte, or null if none was found.
+ */
+const byte* FindAnchor(
+    const byte* begin,
+    const byte* end,
+    const byte* anchor,
+    size_t length);
+
+/* Check if a signature matches, ignoring relocated bytes */
+bool MatchesRelocated(
+    const byte* data,
+    const Signature& signature,
+    const RelocationMap& relocations);
+
+/* Find the first match of a signature within a memory block
+ *
+ * If a relocation map is supplied, relocated bytes are treated as wildcards.
+ * Candidates at addresses that are ineligible for the signature (see
+ * <Signature::SetAlignment>) are skipped.
+ *
+ * @begin The start of the memory block.
+ *
+ * @end The end of the memory block (exclusive).
+ *
+ * @signature The signature.
+ *
+ * @anchor The anchor of the signature (see <SelectAnchor>).
+ *
+ * @relocations An optional relocation map.
+ *
+ * @counters Optional counters of the candidates and verifications.
+ *
+ * @return The start of the first match, or null if none is found.
+ */
+const byte* FindInBlock(
+    const byte* begin,
+    const byte* end,
+    const Signature& signature,
+    const Anchor& anchor,
+    const RelocationMap* relocations,
+    ScanStatistics::Counters* counters = nullptr);
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#ifdef _MSC_VER
+# include <intrin.h>
+#endif
+
+/* Bit manipulation helpers
+ *
+ * Thin wrappers around compiler intrinsics. The argument must be non-zero.
+ */
+namespace Bits {
+inline unsigned int CountTrailingZeros(uint64_t value) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward64(&index, value);
+  return index;
+#else
+  return __builtin_ctzll(value);
+#endif
+}
+
+inline unsigned int CountTrailingZeros(uint32_t value) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward(&index, value);
+  return index;
+#else
+  return __builtin_ctz(value);
+#endif
+}
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
@@ -0,0 +1,97 @@
+#include <cassert>
+
+#include "ByteProfile.hpp"
+
+namespace {
+/* Byte frequencies of x86-64 code
+ *
+ * Counted over the text sections of a set of common shared libraries and
+ * scaled to parts per 65536. Every value is at least one, so no byte is
+ * considered impossible.
+ */
+const uint16_t StaticFrequencies[256] = {
+   7940,  1101,   281,   236,   314,   250,   100,   143,   603,    75,    61,    52,    95,   121,    97,  1818,
+    618,   188,    48,    53,    81,    75,    56,    57,   305,    37,    37,    37,    52,    38,    76,   488,
+    401,    34,    36,    32,  2161,   106,    29,    31,   294,   201,    29,    83,    44,    44,   105,    38,
+    276,   263,    26,    38,    51,   114,    31,    34,   167,   607,    37,    88,    76,    99,    34,    52,
+    368,   617,    55,   191,   793,   282,    84,   109,  5957,   750,    40,    43,  1279,   270,    39,    40,
+    263,    31,    33,   141,   207,   184,    81,    77,   123,    29,    27,   124,   153,   183,    76,    74,
+    179,    26,    39,    64,   148,    45,   431,    35,   110,    31,    32,    46,   108,    43,    52,   122,
+    390,    26,    38,    63,   672,   245,    45,    51,   123,    31,    28,    76,   255,    99,    58,   100,
+    280,    93,    44,   673,   973,   961,    45,    63,   145,  2738,    20,  2341,    60,  1206,    39,    37,
+    235,    28,    31,    39,    90,    76,    28,    29,    80,    29,    25,    29,    54,    57,    27,    29,
+    126,    31,    26,    33,    52,    43,    30,    30,    83,    31,    48,    37,    69,    43,    29,    38,
+    117,    33,    31,    40,    78,    82,   121,    43,   154,    55,   137,    57,   173,   176,   121,    65,
+    511,   162,   122,   370,   157,   166,   244,   561,   123,    86,    55,    37,    46,    41,    50,    49,
+    179,    53,   163,    50,    42,    48,    48,    63,   116,    42,    67,    95,    47,    61,    96,   238,
+    153,    60,    67,    47,    72,    54,    91,   136,  1368,   584,    86,   210,   120,   111,   122,   259,
+    185,    59,    92,   162,    62,    82,   180,   179,   260,   121,   220,   194,   196,   285,   426,  4547,
+};
+
+ByteProfile CreateStaticProfile() {
+  ByteProfile profile;
+
+  // Each byte is added as a separate block, so that no (artificial) pair
+  // information is recorded. Pair frequencies are instead estimated.
+  for(uint i = 0; i < 256; i++) {
+    const byte value = static_cast<byte>(i);
+
+    for(uint x = 0; x < StaticFrequencies[i]; x++) {
+      profile.Add(&value, 1);
+    }
+  }
+
+  return profile;
+}
+}
+
+ByteProfile::ByteProfile() :
+    mBytes(256, 0),
+    mPairs(256 * 256, 0),
+    mByteCount(0),
+    mPairCount(0)
+{
+}
+
+void ByteProfile::Add(const byte* data, size_t size) {
+  assert(data != nullptr || size == 0);
+
+  for(size_t i = 0; i < size; i++) {
+    mBytes[data[i]]++;
+  }
+
+  for(size_t i = 1; i < size; i++) {
+    mPairs[(data[i - 1] << 8) | data[i]]++;
+  }
+
+  mByteCount += size;
+  mPairCount += size ? size - 1 : 0;
+}
+
+double ByteProfile::GetByteFrequency(byte value) const {
+  if(mByteCount == 0) {
+    return 1.0 / 256;
+  }
+
+  return static_cast<double>(mBytes[value]) / mByteCount;
+}
+
+double ByteProfile::GetPairFrequency(byte first, byte second) const {
+  if(mPairCount == 0) {
+    // Without any pair information, assume the bytes are independent
+    return this->GetByteFrequency(first) * this->GetByteFrequency(second);
+  }
+
+  return static_cast<double>(mPairs[(first << 8) | second]) / mPairCount;
+}
+
+uint64_t ByteProfile::GetByteCount() const {
+  return mByteCount;
+}
+
+const ByteProfile& ByteProfile::GetStaticProfile() {
+  static const ByteProfile profile = CreateStaticProfile();
+  return profile;
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
@@ -0,0 +1,48 @@
+#pragma once
+
+/* Runtime CPU feature detection
+ *
+ * Vectorized search kernels beyond the SSE2 baseline are compiled for their
+ * instruction set with target attributes, and are only invoked when the CPU
+ * supports them. This requires GCC or Clang on x86; other configurations use
+ * the SSE2 or scalar kernels.
+ */
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+# define SCANNER_X86_DISPATCH 1
+# define SCANNER_TARGET(isa) __attribute__((target(isa)))
+# include <immintrin.h>
+#else
+# define SCANNER_X86_DISPATCH 0
+#endif
+
+namespace Cpu {
+inline bool HasSsse3() {
+#if SCANNER_X86_DISPATCH
+  static const bool supported = __builtin_cpu_supports("ssse3");
+  return supported;
+#else
+  return false;
+#endif
+}
+
+inline bool HasAvx2() {
+#if SCANNER_X86_DISPATCH
+  static const bool supported = __builtin_cpu_supports("avx2");
+  return supported;
+#else
+  return false;
+#endif
+}
+
+inline bool HasAvx512() {
+#if SCANNER_X86_DISPATCH
+  static const bool supported =
+    __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+  return supported;
+#else
+  return false;
+#endif
+}
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <istream>
+#include <ostream>
+
+#include "FingerprintIndex.hpp"
+#include "Fnv.hpp"
+
+namespace {
+/* Identifies a saved index, followed by its format version */
+const char Magic[4] = { 'S', 'S', 'F', 'P' };
+const uint32_t Version = 1;
+
+/* Write a 64-bit value in little endian byte order */
+void WriteValue(std::ostream& stream, uint64_t value) {
+  byte bytes[8];
+
+  for(size_t i = 0; i < sizeof(bytes); i++) {
+    bytes[i] = static_cast<byte>(value >> (i * 8));
+  }
+
+  stream.write(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+}
+
+/* Read a 64-bit value in little endian byte order */
+bool ReadValue(std::istream& stream, uint64_t* value) {
+  byte bytes[8];
+
+  if(!stream.read(reinterpret_cast<char*>(bytes), sizeof(bytes))) {
+    return false;
+  }
+
+  *value = 0;
+  for(size_t i = 0; i < sizeof(bytes); i++) {
+    *value |= static_cast<uint64_t>(bytes[i]) << (i * 8);
+  }
+
+  return true;
+}
+}
+
+FingerprintIndex::FingerprintIndex(const std::string& buildId /*= std::string()*/) :
+    mBuildId(buildId)
+{
+}
+
+void FingerprintIndex::Add(const Function& function) {
+  assert(mFunctions.empty() || mFunctions.back().offset < function.offset);
+
+  mFingerprints.insert(std::make_pair(function.fingerprint, mFunctions.size()));
+  mFunctions.push_back(function);
+}
+
+const FingerprintIndex::Function* FingerprintIndex::Find(uint64_t fingerprint) const {
+  std::vector<const Function*> functions = this->FindAll(fingerprint);
+  return functions.empty() ? nullptr : functions.front();
+}
+
+std::vector<const FingerprintIndex::Function*>
+FingerprintIndex::FindAll(uint64_t fingerprint) const {
+  std::vector<const Function*> results;
+  auto range = mFingerprints.equal_range(fingerprint);
+
+  for(auto it = range.first; it != range.second; ++it) {
+    results.push_back(&mFunctions[it->second]);
+  }
+
+  std::sort(results.begin(), results.end());
+  return results;
+}
+
+std::vector<const FingerprintIndex::Function*>
+FingerprintIndex::FindChanged(const FingerprintIndex& other) const {
+  std::vector<const Function*> results;
+
+  for(const Function& function : mFunctions) {
+    if(other.mFingerprints.find(function.fingerprint) == other.mFingerprints.end()) {
+      results.push_back(&function);
+    }
+  }
+
+  return results;
+}
+
+bool FingerprintIndex::Save(std::ostream& stream) const {
+  stream.write(Magic, sizeof(Magic));
+  WriteValue(stream, Version);
+  WriteValue(stream, mBuildId.size());
+  stream.write(mBuildId.data(), mBuildId.size());
+  WriteValue(stream, mFunctions.size());
+
+  for(const Function& function : mFunctions) {
+    WriteValue(stream, function.fingerprint);
+    WriteValue(stream, function.offset);
+    WriteValue(stream, function.size);
+  }
+
+  return static_cast<bool>(stream);
+}
+
+bool FingerprintIndex::Load(std::istream& stream, FingerprintIndex* index) {
+  assert(index != nullptr);
+  assert(index->mFunctions.empty());
+
+  char magic[sizeof(Magic)];
+  uint64_t version, length, count;
+
+  if(!stream.read(magic, sizeof(magic)) ||
+      memcmp(magic, Magic, sizeof(Magic)) != 0 ||
+      !ReadValue(stream, &version) || version != Version ||
+      !ReadValue(stream, &length) || length > 1024) {
+    return false;
+  }
+
+  std::string buildId(static_cast<size_t>(length), '\0');
+  if(!stream.read(&buildId[0], buildId.size()) || !ReadValue(stream, &count)) {
+    return false;
+  }
+
+  FingerprintIndex result(buildId);
+
+  for(uint64_t i = 0; i < count; i++) {
+    uint64_t fingerprint, offset, size;
+
+    if(!ReadValue(stream, &fingerprint) ||
+        !ReadValue(stream, &offset) ||
+        !ReadValue(stream, &size) ||
+        (!result.mFunctions.empty() && result.mFunctions.back().offset >= offset)) {
+      return false;
+    }
+
+    result.Add({
+      fingerprint,
+      static_cast<size_t>(offset),
+      static_cast<size_t>(size)
+    });
+  }
+
+  *index = std::move(result);
+  return true;
+}
+
+uint64_t FingerprintIndex::Fingerprint(const byte* code, const byte* masks, size_t size) {
+  assert(code != nullptr || size == 0);
+
+  uint64_t hash = Fnv::Basis;
+
+  for(size_t i = 0; i < sizeof(uint64_t); i++) {
+    hash = Fnv::HashByte(hash, static_cast<byte>(static_cast<uint64_t>(size) >> (i * 8)));
+  }
+
+  for(size_t i = 0; i < size; i++) {
+    hash = Fnv::HashByte(hash, masks ? (code[i] & masks[i]) : code[i]);
+  }
+
+  return hash;
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
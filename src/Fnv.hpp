@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/* 64-bit FNV-1a hash helpers
+ *
+ * Used wherever the scanner needs a cheap, stable hash (e.g cache keys,
+ * function fingerprints and pack checksums). Hashes are persisted, so the
+ * algorithm must never change.
+ */
+namespace Fnv {
+/* The initial value of a hash */
+const uint64_t Basis = 0xCBF29CE484222325ull;
+
+/* Add a byte to a hash */
+inline uint64_t HashByte(uint64_t hash, uint8_t value) {
+  return (hash ^ value) * 0x100000001B3ull;
+}
+
+/* Add a block of memory to a hash */
+inline uint64_t HashBytes(uint64_t hash, const void* data, size_t size) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+  for(size_t i = 0; i < size; i++) {
+    hash = HashByte(hash, bytes[i]);
+  }
+
+  return hash;
+}
+
+/* Add a value to a hash, in native byte order */
+inline uint64_t HashValue(uint64_t hash, uint64_t value) {
+  return HashBytes(hash, &value, sizeof(value));
+}
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
@@ -0,0 +1,37 @@
+#include <algorithm>
+#include <cassert>
+
+#include "FunctionIndex.hpp"
+
+void FunctionIndex::Add(const Function& function) {
+  assert(mFunctions.empty() ||
+    (mFunctions.back().address + mFunctions.back().size) <= function.address);
+
+  mFunctions.push_back(function);
+}
+
+const FunctionIndex::Function* FunctionIndex::Find(uintptr_t address) const {
+  auto function = std::upper_bound(
+    mFunctions.begin(),
+    mFunctions.end(),
+    address,
+    [](uintptr_t value, const Function& entry) { return value < entry.address; });
+
+  if(function == mFunctions.begin()) {
+    return nullptr;
+  }
+
+  --function;
+  return (address - function->address) < function->size ? &*function : nullptr;
+}
+
+std::vector<FunctionIndex::Function>::const_iterator
+FunctionIndex::LowerBound(uintptr_t address) const {
+  return std::lower_bound(
+    mFunctions.begin(),
+    mFunctions.end(),
+    address,
+    [](const Function& entry, uintptr_t value) { return entry.address < value; });
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
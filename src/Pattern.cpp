@@ -0,0 +1,658 @@
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <cstring>
+#include <map>
+
+#include "ByteProfile.hpp"
+#include "Pattern.hpp"
+
+namespace {
+/* The largest supported gap, in bytes */
+const size_t MaxGap = 4096;
+
+/* The largest number of deterministic states before falling back to NFA
+ * simulation. Each state occupies a kilobyte of transitions. */
+const size_t MaxDeterministicStates = 4096;
+
+/* Pattern syntax tree
+ *
+ * Nodes are stored in a flat vector and refer to their children by index.
+ */
+struct Node {
+  enum Type { Set, Gap, Sequence, Alternation };
+
+  Type type;
+  std::bitset<256> set;
+  size_t min;
+  size_t max;
+  std::vector<size_t> children;
+};
+
+/* Recursive descent parser for the pattern syntax */
+class Parser {
+public:
+  explicit Parser(const std::string& text) : mText(text), mPosition(0) { }
+
+  size_t Parse() {
+    size_t root = this->ParseAlternation();
+
+    this->SkipSpace();
+    if(mPosition != mText.size()) {
+      this->Fail("unexpected character");
+    }
+
+    return root;
+  }
+
+  std::vector<Node> nodes;
+
+private:
+  size_t ParseAlternation() {
+    std::vector<size_t> alternatives(1, this->ParseSequence());
+
+    while(this->Accept('|')) {
+      alternatives.push_back(this->ParseSequence());
+    }
+
+    if(alternatives.size() == 1) {
+      return alternatives[0];
+    }
+
+    return this->AddNode(Node::Alternation, alternatives);
+  }
+
+  size_t ParseSequence() {
+    std::vector<size_t> items;
+
+    for(;;) {
+      this->SkipSpace();
+
+      if(mPosition == mText.size() || mText[mPosition] == '|' ||
+          mText[mPosition] == ')') {
+        break;
+      }
+
+      items.push_back(this->ParseItem());
+    }
+
+    if(items.empty()) {
+      this->Fail("empty sequence");
+    }
+
+    return (items.size() == 1) ? items[0] : this->AddNode(Node::Sequence, items);
+  }
+
+  size_t ParseItem() {
+    if(this->Accept('(')) {
+      size_t node = this->ParseAlternation();
+      this->Expect(')');
+      return node;
+    }
+
+    if(this->Accept('{')) {
+      return this->ParseSet();
+    }
+
+    if(this->Accept('[')) {
+      return this->ParseGap();
+    }
+
+    return this->ParseByte();
+  }
+
+  size_t ParseByte() {
+    size_t node = this->AddNode(Node::Set, std::vector<size_t>());
+
+    // A single question mark matches any byte
+    if(mText[mPosition] == '?' && !this->IsDigit(mPosition + 1)) {
+      mPosition++;
+      nodes[node].set.set();
+      return node;
+    }
+
+    byte value, mask;
+    this->ReadByte(&value, &mask, true);
+
+    if(this->Accept('&', false)) {
+      byte explicitMask, explicitMaskMask;
+      this->ReadByte(&explicitMask, &explicitMaskMask, false);
+      mask &= explicitMask;
+    }
+
+    for(uint i = 0; i < 256; i++) {
+      if((i & mask) == (value & mask)) {
+        nodes[node].set.set(i);
+      }
+    }
+
+    return node;
+  }
+
+  size_t ParseSet() {
+    size_t node = this->AddNode(Node::Set, std::vector<size_t>());
+    bool negate = this->Accept('^');
+
+    while(!this->Accept('}')) {
+      byte lower, upper, mask;
+
+      this->SkipSpace();
+      this->ReadByte(&lower, &mask, false);
+      upper = lower;
+
+      if(this->Accept('-', false)) {
+        this->ReadByte(&upper, &mask, false);
+      }
+
+      if(upper < lower) {
+        this->Fail("descending byte range");
+      }
+
+      for(uint i = lower; i <= upper; i++) {
+        nodes[node].set.set(i);
+      }
+    }
+
+    if(negate) {
+      nodes[node].set.flip();
+    }
+
+    if(nodes[node].set.none()) {
+      this->Fail("empty byte set");
+    }
+
+    return node;
+  }
+
+  size_t ParseGap() {
+    size_t node = this->AddNode(Node::Gap, std::vector<size_t>());
+
+    nodes[node].min = this->ReadNumber();
+    nodes[node].max = this->Accept('-') ? this->ReadNumber() : nodes[node].min;
+    this->Expect(']');
+
+    if(nodes[node].min > nodes[node].max || nodes[node].max > MaxGap) {
+      this->Fail("invalid gap bounds");
+    }
+
+    return node;
+  }
+
+  void ReadByte(byte* value, byte* mask, bool wildcards) {
+    *value = 0;
+    *mask = 0;
+
+    for(int i = 0; i < 2; i++, mPosition++) {
+      char digit = (mPosition < mText.size()) ? mText[mPosition] : '\0';
+
+      *value <<= 4;
+      *mask <<= 4;
+
+      if(digit == '?' && wildcards) {
+        continue;
+      }
+
+      if(!isxdigit(static_cast<unsigned char>(digit))) {
+        this->Fail("malformed byte");
+      }
+
+      *value |= isdigit(static_cast<unsigned char>(digit)) ?
+        digit - '0' : (tolower(static_cast<unsigned char>(digit)) - 'a') + 10;
+      *mask |= 0xF;
+    }
+  }
+
+  size_t ReadNumber() {
+    this->SkipSpace();
+
+    if(mPosition == mText.size() || !isdigit(static_cast<unsigned char>(mText[mPosition]))) {
+      this->Fail("expected a number");
+    }
+
+    size_t number = 0;
+    while(mPosition < mText.size() && isdigit(static_cast<unsigned char>(mText[mPosition]))) {
+      number = std::min(number * 10 + (mText[mPosition++] - '0'), MaxGap + 1);
+    }
+
+    return number;
+  }
+
+  bool IsDigit(size_t position) const {
+    return position < mText.size() && (mText[position] == '?' ||
+      isxdigit(static_cast<unsigned char>(mText[position])));
+  }
+
+  size_t AddNode(Node::Type type, const std::vector<size_t>& children) {
+    Node node;
+    node.type = type;
+    node.min = 0;
+    node.max = 0;
+    node.children = children;
+
+    nodes.push_back(node);
+    return nodes.size() - 1;
+  }
+
+  void SkipSpace() {
+    while(mPosition < mText.size() && isspace(static_cast<unsigned char>(mText[mPosition]))) {
+      mPosition++;
+    }
+  }
+
+  bool Accept(char character, bool skipSpace = true) {
+    if(skipSpace) {
+      this->SkipSpace();
+    }
+
+    if(mPosition < mText.size() && mText[mPosition] == character) {
+      mPosition++;
+      return true;
+    }
+
+    return false;
+  }
+
+  void Expect(char character) {
+    if(!this->Accept(character)) {
+      this->Fail(std::string("expected '") + character + "'");
+    }
+  }
+
+  void Fail(const std::string& error) const {
+    throw Pattern::Exception(error + " at position " + std::to_string(mPosition));
+  }
+
+  const std::string& mText;
+  size_t mPosition;
+};
+
+/* Calculate the minimum and maximum length of a node */
+void GetLengths(const std::vector<Node>& nodes, size_t index, size_t* min, size_t* max) {
+  const Node& node = nodes[index];
+
+  switch(node.type) {
+  case Node::Set:
+    *min = *max = 1;
+    break;
+  case Node::Gap:
+    *min = node.min;
+    *max = node.max;
+    break;
+  case Node::Sequence:
+  case Node::Alternation:
+    *min = (node.type == Node::Sequence) ? 0 : static_cast<size_t>(-1);
+    *max = 0;
+
+    for(size_t child : node.children) {
+      size_t childMin = 0, childMax = 0;
+      GetLengths(nodes, child, &childMin, &childMax);
+
+      if(node.type == Node::Sequence) {
+        *min += childMin;
+        *max += childMax;
+      } else {
+        *min = std::min(*min, childMin);
+        *max = std::max(*max, childMax);
+      }
+    }
+    break;
+  default:
+    assert(false);
+    *min = *max = 0;
+    break;
+  }
+}
+
+/* Flatten nested sequences into a single list of items */
+void Flatten(const std::vector<Node>& nodes, size_t index, std::vector<size_t>* items) {
+  if(nodes[index].type != Node::Sequence) {
+    items->push_back(index);
+    return;
+  }
+
+  for(size_t child : nodes[index].children) {
+    Flatten(nodes, child, items);
+  }
+}
+}
+
+/* Thompson NFA and its (optional) deterministic equivalent
+ *
+ * NFA states either consume a byte from their set and continue to 'next', or
+ * continue to all of their epsilon states. State zero is the accepting state.
+ */
+struct Pattern::Automaton {
+  struct State {
+    std::bitset<256> set;
+    int next;
+    std::vector<int> epsilons;
+  };
+
+  std::vector<State> states;
+  int entry;
+
+  // Deterministic transitions (256 per state), empty if too complex
+  std::vector<int32_t> transitions;
+  std::vector<bool> accepting;
+
+  int AddState(const std::bitset<256>& set, int next) {
+    State state;
+    state.set = set;
+    state.next = next;
+
+    states.push_back(state);
+    return static_cast<int>(states.size() - 1);
+  }
+
+  int AddSplit(const std::vector<int>& epsilons) {
+    int state = this->AddState(std::bitset<256>(), -1);
+    states[state].epsilons = epsilons;
+    return state;
+  }
+
+  /* Compile a node, given the state to continue to, returning its entry */
+  int Compile(const std::vector<Node>& nodes, size_t index, int out) {
+    const Node& node = nodes[index];
+    std::bitset<256> any;
+    any.set();
+
+    switch(node.type) {
+    case Node::Set:
+      return this->AddState(node.set, out);
+    case Node::Gap: {
+      int current = out;
+
+      for(size_t i = node.min; i < node.max; i++) {
+        int consume = this->AddState(any, current);
+        current = this->AddSplit(std::vector<int>{ consume, out });
+      }
+
+      for(size_t i = 0; i < node.min; i++) {
+        current = this->AddState(any, current);
+      }
+
+      return current;
+    }
+    case Node::Sequence:
+      for(size_t i = node.children.size(); i-- > 0;) {
+        out = this->Compile(nodes, node.children[i], out);
+      }
+      return out;
+    case Node::Alternation: {
+      std::vector<int> entries;
+
+      for(size_t child : node.children) {
+        entries.push_back(this->Compile(nodes, child, out));
+      }
+
+      return this->AddSplit(entries);
+    }
+    }
+
+    return out;
+  }
+
+  void AddClosure(int state, std::vector<char>* active) const {
+    if((*active)[state]) {
+      return;
+    }
+
+    (*active)[state] = 1;
+    for(int epsilon : states[state].epsilons) {
+      this->AddClosure(epsilon, active);
+    }
+  }
+
+  void Step(const std::vector<char>& active, byte value, std::vector<char>* next) const {
+    std::fill(next->begin(), next->end(), 0);
+
+    for(size_t i = 0; i < states.size(); i++) {
+      if(active[i] && states[i].next >= 0 && states[i].set.test(value)) {
+        this->AddClosure(states[i].next, next);
+      }
+    }
+  }
+
+  void Determinize() {
+    std::map<std::vector<char>, int32_t> identifiers;
+    std::vector<std::vector<char>> pending;
+
+    std::vector<char> start(states.size(), 0);
+    this->AddClosure(entry, &start);
+
+    identifiers[start] = 0;
+    pending.push_back(start);
+    accepting.push_back(start[0] != 0);
+    transitions.assign(256, -1);
+
+    // Bytes that are members of the same sets behave identically, so only a
+    // single representative of each class needs to be stepped.
+    std::map<std::vector<bool>, std::vector<byte>> classes;
+    for(uint value = 0; value < 256; value++) {
+      std::vector<bool> membership(states.size());
+
+      for(size_t i = 0; i < states.size(); i++) {
+        membership[i] = states[i].set.test(value);
+      }
+
+      classes[membership].push_back(static_cast<byte>(value));
+    }
+
+    std::vector<char> next(states.size());
+
+    for(size_t current = 0; current < pending.size(); current++) {
+      // Matching stops at the first accepting state
+      if(accepting[current]) {
+        continue;
+      }
+
+      for(const auto& members : classes) {
+        this->Step(pending[current], members.second[0], &next);
+
+        if(std::find(next.begin(), next.end(), 1) == next.end()) {
+          continue;
+        }
+
+        std::map<std::vector<char>, int32_t>::iterator it = identifiers.find(next);
+        if(it == identifiers.end()) {
+          if(pending.size() == MaxDeterministicStates) {
+            transitions.clear();
+            accepting.clear();
+            return;
+          }
+
+          it = identifiers.insert(std::make_pair(next, static_cast<int32_t>(pending.size()))).first;
+          pending.push_back(next);
+          accepting.push_back(next[0] != 0);
+          transitions.resize(transitions.size() + 256, -1);
+        }
+
+        for(byte value : members.second) {
+          transitions[current * 256 + value] = it->second;
+        }
+      }
+    }
+  }
+};
+
+Pattern::Pattern(const std::string& pattern) :
+    mLiteralAnchor(0),
+    mMinPrefix(0),
+    mMaxPrefix(0),
+    mMinLength(0),
+    mMaxLength(0)
+{
+  Parser parser(pattern);
+  const size_t root = parser.Parse();
+  const std::vector<Node>& nodes = parser.nodes;
+
+  GetLengths(nodes, root, &mMinLength, &mMaxLength);
+  if(mMinLength == 0) {
+    throw Exception("pattern can match an empty sequence");
+  }
+
+  std::shared_ptr<Automaton> automaton = std::make_shared<Automaton>();
+  automaton->AddState(std::bitset<256>(), -1);
+  automaton->entry = automaton->Compile(nodes, root, 0);
+  automaton->Determinize();
+
+  // Determine the bytes that can start a match
+  std::vector<char> start(automaton->states.size(), 0);
+  automaton->AddClosure(automaton->entry, &start);
+
+  for(size_t i = 0; i < start.size(); i++) {
+    if(start[i] && automaton->states[i].next >= 0) {
+      mFirstBytes |= automaton->states[i].set;
+    }
+  }
+
+  mAutomaton = automaton;
+
+  // Find the longest literal that is part of every match, along with the
+  // bounds of the distance between the start of a match and the literal.
+  std::vector<size_t> items;
+  Flatten(nodes, root, &items);
+
+  size_t minPrefix = 0, maxPrefix = 0;
+  std::vector<byte> literal;
+
+  for(size_t i = 0; i <= items.size(); i++) {
+    const bool isLiteral = i < items.size() &&
+      nodes[items[i]].type == Node::Set && nodes[items[i]].set.count() == 1;
+
+    if(isLiteral) {
+      for(uint value = 0; value < 256; value++) {
+        if(nodes[items[i]].set.test(value)) {
+          literal.push_back(static_cast<byte>(value));
+        }
+      }
+    } else {
+      if(literal.size() > mLiteral.size()) {
+        mLiteral = literal;
+        mMinPrefix = minPrefix - literal.size();
+        mMaxPrefix = maxPrefix - literal.size();
+      }
+
+      literal.clear();
+    }
+
+    if(i < items.size()) {
+      size_t min, max;
+      GetLengths(nodes, items[i], &min, &max);
+
+      minPrefix += min;
+      maxPrefix += max;
+    }
+  }
+
+  // The rarest byte of the literal is searched for first
+  const ByteProfile& profile = ByteProfile::GetStaticProfile();
+  for(size_t i = 1; i < mLiteral.size(); i++) {
+    if(profile.GetByteFrequency(mLiteral[i]) <
+        profile.GetByteFrequency(mLiteral[mLiteralAnchor])) {
+      mLiteralAnchor = i;
+    }
+  }
+}
+
+const byte* Pattern::Find(const byte* begin, const byte* end) const {
+  assert(begin <= end);
+
+  const size_t size = end - begin;
+  if(size < mMinLength) {
+    return nullptr;
+  }
+
+  if(mLiteral.empty()) {
+    for(const byte* candidate = begin; candidate <= (end - mMinLength); candidate++) {
+      if(mFirstBytes.test(*candidate) && this->Matches(candidate, end)) {
+        return candidate;
+      }
+    }
+
+    return nullptr;
+  }
+
+  // Offsets are relative to 'begin'. Each literal occurrence implies a range
+  // of candidate starts, which are tried in ascending order exactly once.
+  const size_t tail = mLiteral.size() - mLiteralAnchor;
+  size_t untried = 0;
+
+  for(size_t position = mMinPrefix + mLiteralAnchor; (position + tail) <= size; position++) {
+    const byte* hit = static_cast<const byte*>(memchr(
+      begin + position,
+      mLiteral[mLiteralAnchor],
+      size - tail + 1 - position));
+
+    if(hit == nullptr) {
+      break;
+    }
+
+    position = hit - begin;
+
+    const size_t literal = position - mLiteralAnchor;
+    if(memcmp(begin + literal, mLiteral.data(), mLiteral.size()) != 0) {
+      continue;
+    }
+
+    const size_t first = std::max(untried,
+      literal > mMaxPrefix ? literal - mMaxPrefix : 0);
+    const size_t last = literal - mMinPrefix;
+
+    for(size_t candidate = first; candidate <= last; candidate++) {
+      if(this->Matches(begin + candidate, end)) {
+        return begin + candidate;
+      }
+    }
+
+    untried = std::max(untried, last + 1);
+  }
+
+  return nullptr;
+}
+
+const byte* Pattern::Matches(const byte* begin, const byte* end) const {
+  assert(begin <= end);
+
+  const Automaton& automaton = *mAutomaton;
+
+  if(!automaton.transitions.empty()) {
+    int32_t state = 0;
+
+    for(const byte* position = begin; position < end; position++) {
+      state = automaton.transitions[state * 256 + *position];
+
+      if(state < 0) {
+        return nullptr;
+      }
+
+      if(automaton.accepting[state]) {
+        return position + 1;
+      }
+    }
+
+    return nullptr;
+  }
+
+  // The pattern was too complex to determinize; simulate the NFA instead
+  std::vector<char> active(automaton.states.size(), 0);
+  std::vector<char> next(automaton.states.size(), 0);
+  automaton.AddClosure(automaton.entry, &active);
+
+  for(const byte* position = begin; position < end; position++) {
+    automaton.Step(active, *position, &next);
+    active.swap(next);
+
+    if(active[0]) {
+      return position + 1;
+    }
+
+    if(std::find(active.begin(), active.end(), 1) == active.end()) {
+      break;
+    }
+  }
+
+  return nullptr;
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
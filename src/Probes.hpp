@@ -0,0 +1,30 @@
+#pragma once
+
+/* Static tracepoints
+ *
+ * SystemTap style (USDT) probes at the phases of a scan, under the provider
+ * 'signature_scanner'. They are only compiled in when the library is built
+ * with 'SCANNER_PROBES', which requires 'sys/sdt.h' (e.g 'systemtap-sdt-dev').
+ * An inactive probe is a single 'nop' instruction; tools such as bpftrace
+ * or perf attach to them in a running process, e.g:
+ *
+ *   bpftrace -e 'usdt:./app:signature_scanner:match { printf("%x\n", arg2 - arg0); }'
+ *
+ * Probes and their arguments, where 'base' is the base of the module being
+ * searched, and a signature ID is a hash of the values and masks of a
+ * signature (stable across searches, batches and processes):
+ *
+ *   construct       (base, size)
+ *   region          (begin, end, eligible)
+ *   scan_start      (base, begin, end, signature count)
+ *   scan_end        (base, begin, end, signature count)
+ *   match           (base, signature ID, address)
+ */
+#ifdef SCANNER_PROBES
+# include <sys/sdt.h>
+# define SCANNER_PROBE(...) STAP_PROBEV(signature_scanner, __VA_ARGS__)
+#else
+# define SCANNER_PROBE(...) do { } while(0)
+#endif
+
+/* vim: set ts=2 sw=2 expandtab: */
@@ -0,0 +1,348 @@
+#include <cassert>
+#include <cstring>
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
+
+#include "Bits.hpp"
+#include "Cpu.hpp"
+#include "ReferenceSearch.hpp"
+
+namespace {
+/* Add candidate operands to the output if their destination is in range
+ *
+ * Each bit of 'candidates' represents the operand at 'position + bit'.
+ */
+void AddCandidates(
+    const byte* position,
+    uint32_t candidates,
+    uintptr_t lower,
+    uintptr_t upper,
+    bool relative,
+    std::vector<const byte*>* operands) {
+  while(candidates != 0) {
+    const byte* operand = position + Bits::CountTrailingZeros(candidates);
+    const uintptr_t destination = relative ?
+      ReferenceSearch::GetDestination(operand) : ReferenceSearch::GetValue(operand);
+
+    // The vectorized comparison is performed modulo 2^32, so it may yield
+    // false positives which are discarded here.
+    if(destination >= lower && destination <= upper) {
+      operands->push_back(operand);
+    }
+
+    candidates &= candidates - 1;
+  }
+}
+
+/* Calculate 'destination - lower' for each operand, modulo 2^32, as
+ * '(position + 4 - lower) + rel32' for relative operands, or as
+ * 'value - lower' (of the lower 32 bits) for absolute operands. The
+ * operands of a vector loaded at 'position + j' are located at 'j + 4k' for
+ * lane 'k'. The distance is compared (unsigned, through a sign bias)
+ * against the range size. */
+
+#if SCANNER_X86_DISPATCH
+SCANNER_TARGET("avx2")
+const byte* FindOperandsAvx2(
+    const byte* position,
+    const byte* end,
+    uintptr_t lower,
+    uintptr_t upper,
+    bool relative,
+    std::vector<const byte*>* operands) {
+  const __m256i bias = _mm256_set1_epi32(static_cast<int>(0x80000000u));
+  const __m256i range = _mm256_xor_si256(
+    _mm256_set1_epi32(static_cast<int>(static_cast<uint32_t>(upper - lower))), bias);
+  const __m256i step = _mm256_set1_epi32(relative ? 32 : 0);
+  const uint32_t lane = relative ? 4 : 0;
+
+  __m256i offsets[4];
+  for(int j = 0; j < 4; j++) {
+    const uint32_t base = static_cast<uint32_t>(relative ?
+      reinterpret_cast<uintptr_t>(position) + 4 - lower + j : 0 - lower);
+
+    offsets[j] = _mm256_setr_epi32(
+      base, base + lane, base + 2 * lane, base + 3 * lane,
+      base + 4 * lane, base + 5 * lane, base + 6 * lane, base + 7 * lane);
+  }
+
+  // The last load reads 32 bytes from 'position + 3', and candidates are
+  // verified by reading the complete operand.
+  const ptrdiff_t tail = relative ? 0 : sizeof(uintptr_t) - sizeof(uint32_t);
+
+  for(; (end - position) >= (35 + tail); position += 32) {
+    uint32_t candidates = 0;
+
+    for(int j = 0; j < 4; j++) {
+      const __m256i operand = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(position + j));
+      const __m256i distance = _mm256_xor_si256(
+        _mm256_add_epi32(operand, offsets[j]), bias);
+
+      // Lanes that are not greater than the range are candidates
+      uint32_t outside = _mm256_movemask_ps(_mm256_castsi256_ps(
+        _mm256_cmpgt_epi32(distance, range)));
+
+      for(uint32_t inside = ~outside & 0xFF; inside != 0; inside &= inside - 1) {
+        candidates |= 1u << (j + 4 * Bits::CountTrailingZeros(inside));
+      }
+
+      offsets[j] = _mm256_add_epi32(offsets[j], step);
+    }
+
+    if(candidates != 0) {
+      AddCandidates(position, candidates, lower, upper, relative, operands);
+    }
+  }
+
+  return position;
+}
+#endif
+
+#ifdef __SSE2__
+const byte* FindOperandsSse2(
+    const byte* position,
+    const byte* end,
+    uintptr_t lower,
+    uintptr_t upper,
+    bool relative,
+    std::vector<const byte*>* operands) {
+  const __m128i bias = _mm_set1_epi32(static_cast<int>(0x80000000u));
+  const __m128i range = _mm_xor_si128(
+    _mm_set1_epi32(static_cast<int>(static_cast<uint32_t>(upper - lower))), bias);
+  const __m128i step = _mm_set1_epi32(relative ? 16 : 0);
+  const uint32_t lane = relative ? 4 : 0;
+
+  __m128i offsets[4];
+  for(int j = 0; j < 4; j++) {
+    const uint32_t base = static_cast<uint32_t>(relative ?
+      reinterpret_cast<uintptr_t>(position) + 4 - lower + j : 0 - lower);
+
+    offsets[j] = _mm_setr_epi32(base, base + lane, base + 2 * lane, base + 3 * lane);
+  }
+
+  // The last load reads 16 bytes from 'position + 3', and candidates are
+  // verified by reading the complete operand.
+  const ptrdiff_t tail = relative ? 0 : sizeof(uintptr_t) - sizeof(uint32_t);
+
+  for(; (end - position) >= (19 + tail); position += 16) {
+    uint32_t candidates = 0;
+
+    for(int j = 0; j < 4; j++) {
+      const __m128i operand = _mm_loadu_si128(
+        reinterpret_cast<const __m128i*>(position + j));
+      const __m128i distance = _mm_xor_si128(
+        _mm_add_epi32(operand, offsets[j]), bias);
+
+      uint32_t outside = _mm_movemask_ps(_mm_castsi128_ps(
+        _mm_cmpgt_epi32(distance, range)));
+
+      for(uint32_t inside = ~outside & 0xF; inside != 0; inside &= inside - 1) {
+        candidates |= 1u << (j + 4 * Bits::CountTrailingZeros(inside));
+      }
+
+      offsets[j] = _mm_add_epi32(offsets[j], step);
+    }
+
+    if(candidates != 0) {
+      AddCandidates(position, candidates, lower, upper, relative, operands);
+    }
+  }
+
+  return position;
+}
+#endif
+
+/* Find aligned 64-bit values within a range, four slots per vector. The
+ * values are compared (unsigned, through a sign bias) as 'value - lower'
+ * against the range size. */
+
+#if SCANNER_X86_DISPATCH && defined(__x86_64__)
+SCANNER_TARGET("avx2")
+const uintptr_t* FindPointersAvx2(
+    const uintptr_t* position,
+    const uintptr_t* end,
+    uintptr_t lower,
+    uintptr_t upper,
+    std::vector<const byte*>* pointers) {
+  const __m256i bias = _mm256_set1_epi64x(static_cast<long long>(0x8000000000000000ull));
+  const __m256i base = _mm256_set1_epi64x(static_cast<long long>(lower));
+  const __m256i range = _mm256_xor_si256(
+    _mm256_set1_epi64x(static_cast<long long>(upper - lower)), bias);
+
+  for(; (end - position) >= 8; position += 8) {
+    const __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(position));
+    const __m256i second = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(position + 4));
+
+    // Slots whose distance is greater than the range are outside of it
+    const __m256i outsideFirst = _mm256_cmpgt_epi64(
+      _mm256_xor_si256(_mm256_sub_epi64(first, base), bias), range);
+    const __m256i outsideSecond = _mm256_cmpgt_epi64(
+      _mm256_xor_si256(_mm256_sub_epi64(second, base), bias), range);
+
+    uint32_t inside = ~(
+      _mm256_movemask_pd(_mm256_castsi256_pd(outsideFirst)) |
+      (_mm256_movemask_pd(_mm256_castsi256_pd(outsideSecond)) << 4)) & 0xFF;
+
+    for(; inside != 0; inside &= inside - 1) {
+      pointers->push_back(reinterpret_cast<const byte*>(
+        position + Bits::CountTrailingZeros(inside)));
+    }
+  }
+
+  return position;
+}
+#endif
+
+/* Find relative or absolute operands referring to an address range */
+void SearchOperands(
+    const byte* begin,
+    const byte* end,
+    uintptr_t lower,
+    uintptr_t upper,
+    bool relative,
+    std::vector<const byte*>* operands) {
+  assert(operands != nullptr);
+  assert(lower <= upper);
+
+  const byte* position = begin;
+
+  // The vectorized kernels compare 32-bit distances
+  if((upper - lower) <= 0xFFFFFFFFu) {
+#if SCANNER_X86_DISPATCH
+    if(Cpu::HasAvx2()) {
+      position = FindOperandsAvx2(position, end, lower, upper, relative, operands);
+    }
+#endif
+#ifdef __SSE2__
+    position = FindOperandsSse2(position, end, lower, upper, relative, operands);
+#endif
+  }
+
+  const size_t size = relative ? sizeof(int32_t) : sizeof(uintptr_t);
+
+  for(; static_cast<size_t>(end - position) >= size; position++) {
+    const uintptr_t destination = relative ?
+      ReferenceSearch::GetDestination(position) : ReferenceSearch::GetValue(position);
+
+    if(destination >= lower && destination <= upper) {
+      operands->push_back(position);
+    }
+  }
+}
+}
+
+void ReferenceSearch::FindOperands(
+    const byte* begin,
+    const byte* end,
+    uintptr_t lower,
+    uintptr_t upper,
+    std::vector<const byte*>* operands) {
+  SearchOperands(begin, end, lower, upper, true, operands);
+}
+
+void ReferenceSearch::FindValues(
+    const byte* begin,
+    const byte* end,
+    uintptr_t lower,
+    uintptr_t upper,
+    std::vector<const byte*>* values) {
+  SearchOperands(begin, end, lower, upper, false, values);
+}
+
+void ReferenceSearch::FindPointers(
+    const byte* begin,
+    const byte* end,
+    uintptr_t lower,
+    uintptr_t upper,
+    std::vector<const byte*>* pointers) {
+  assert(pointers != nullptr);
+  assert(lower <= upper);
+
+  const uintptr_t alignment = sizeof(uintptr_t);
+  const uintptr_t first = (reinterpret_cast<uintptr_t>(begin) + alignment - 1) & ~(alignment - 1);
+  const uintptr_t last = reinterpret_cast<uintptr_t>(end) & ~(alignment - 1);
+
+  if(first >= last) {
+    return;
+  }
+
+  const uintptr_t* position = reinterpret_cast<const uintptr_t*>(first);
+  const uintptr_t* limit = reinterpret_cast<const uintptr_t*>(last);
+
+#if SCANNER_X86_DISPATCH && defined(__x86_64__)
+  if(Cpu::HasAvx2()) {
+    position = FindPointersAvx2(position, limit, lower, upper, pointers);
+  }
+#endif
+
+  for(; position < limit; position++) {
+    // A single unsigned comparison covers both bounds
+    if((*position - lower) <= (upper - lower)) {
+      pointers->push_back(reinterpret_cast<const byte*>(position));
+    }
+  }
+}
+
+const byte* ReferenceSearch::GetInstruction(const byte* begin, const byte* operand) {
+  auto at = [&](ptrdiff_t offset) -> int {
+    return (operand + offset >= begin) ? operand[offset] : -1;
+  };
+
+  // call rel32, jmp rel32
+  if(at(-1) == 0xE8 || at(-1) == 0xE9) {
+    return operand - 1;
+  }
+
+  // jcc rel32
+  if(at(-2) == 0x0F && at(-1) >= 0x80 && at(-1) <= 0x8F) {
+    return operand - 2;
+  }
+
+  // ModRM with mod 00 and r/m 101 (i.e RIP-relative)
+  if(at(-1) < 0 || (at(-1) & 0xC7) != 0x05 || at(-2) < 0) {
+    return nullptr;
+  }
+
+  ptrdiff_t start = -2;
+
+  if(at(start - 1) == 0x0F) {
+    start--;
+  }
+
+  if(at(start - 1) >= 0x40 && at(start - 1) <= 0x4F) {
+    start--;
+  }
+
+  if(at(start - 1) == 0x66 || at(start - 1) == 0xF2 || at(start - 1) == 0xF3) {
+    start--;
+  }
+
+  return operand + start;
+}
+
+const byte* ReferenceSearch::GetAbsoluteInstruction(const byte* begin, const byte* value) {
+  if((value - begin) >= 2 && value[-1] >= 0xB8 && value[-1] <= 0xBF &&
+      value[-2] >= 0x48 && value[-2] <= 0x4F) {
+    return value - 2;
+  }
+
+  return value;
+}
+
+uintptr_t ReferenceSearch::GetValue(const byte* operand) {
+  uintptr_t value;
+  memcpy(&value, operand, sizeof(value));
+
+  return value;
+}
+
+uintptr_t ReferenceSearch::GetDestination(const byte* operand) {
+  int32_t displacement;
+  memcpy(&displacement, operand, sizeof(displacement));
+
+  return reinterpret_cast<uintptr_t>(operand) + 4 + displacement;
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace {
+typedef unsigned char byte;
+}
+
+/* Relative reference search
+ *
+ * Finds 32-bit relative operands (e.g of 'call rel32' or RIP-relative
+ * addressing) whose destination lies within an address range. The
+ * destination of an operand at 'q' is 'q + 4 + rel32', i.e the operand is
+ * assumed to be the last part of its instruction.
+ */
+namespace ReferenceSearch {
+/* Find operands referring to an address range
+ *
+ * @begin The start of the memory block.
+ *
+ * @end The end of the memory block (exclusive).
+ *
+ * @lower The lower bound of the destination range (inclusive).
+ *
+ * @upper The upper bound of the destination range (inclusive).
+ *
+ * @operands A vector receiving the operand addresses, in ascending order.
+ */
+void FindOperands(
+    const byte* begin,
+    const byte* end,
+    uintptr_t lower,
+    uintptr_t upper,
+    std::vector<const byte*>* operands);
+
+/* Find absolute values referring to an address range
+ *
+ * Every (unaligned) pointer sized value within the block is considered.
+ *
+ * @begin The start of the memory block.
+ *
+ * @end The end of the memory block (exclusive).
+ *
+ * @lower The lower bound of the value range (inclusive).
+ *
+ * @upper The upper bound of the value range (inclusive).
+ *
+ * @values A vector receiving the value addresses, in ascending order.
+ */
+void FindValues(
+    const byte* begin,
+    const byte* end,
+    uintptr_t lower,
+    uintptr_t upper,
+    std::vector<const byte*>* values);
+
+/* Find aligned pointers into an address range
+ *
+ * Only pointer sized values at addresses aligned to their size are
+ * considered, as is the case for pointers stored by a compiler.
+ *
+ * @begin The start of the memory block.
+ *
+ * @end The end of the memory block (exclusive).
+ *
+ * @lower The lower bound of the value range (inclusive).
+ *
+ * @upper The upper bound of the value range (inclusive).
+ *
+ * @pointers A vector receiving the pointer addresses, in ascending order.
+ */
+void FindPointers(
+    const byte* begin,
+    const byte* end,
+    uintptr_t lower,
+    uintptr_t upper,
+    std::vector<const byte*>* pointers);
+
+/* Get the instruction an operand belongs to
+ *
+ * Recognizes 'call rel32', 'jmp rel32', 'jcc rel32' and instructions with a
+ * RIP-relative ModRM operand, including REX, 0F and common legacy prefixes.
+ *
+ * @begin The start of the memory block (nothing before it is read).
+ *
+ * @operand The address of the relative operand.
+ *
+ * @return The start of the instruction, otherwise null.
+ */
+const byte* GetInstruction(const byte* begin, const byte* operand);
+
+/* Get the instruction an absolute value belongs to
+ *
+ * Recognizes 'movabs' (REX.W B8+r). Other values are not decoded, in which
+ * case the address of the value itself is returned.
+ *
+ * @begin The start of the memory block (nothing before it is read).
+ *
+ * @value The address of the absolute value.
+ *
+ * @return The start of the instruction, or the address of the value.
+ */
+const byte* GetAbsoluteInstruction(const byte* begin, const byte* value);
+
+/* Get the destination of a relative operand */
+uintptr_t GetDestination(const byte* operand);
+
+/* Get the pointer sized value at an address */
+uintptr_t GetValue(const byte* operand);
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
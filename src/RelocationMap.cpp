@@ -0,0 +1,59 @@
+#include <algorithm>
+
+#include "Bits.hpp"
+#include "RelocationMap.hpp"
+
+RelocationMap::RelocationMap(uintptr_t baseAddress, size_t size) :
+    mBits((size + 63) / 64, 0),
+    mBaseAddress(baseAddress),
+    mSize(size),
+    mCount(0)
+{
+}
+
+void RelocationMap::Add(uintptr_t address, size_t size) {
+  uintptr_t start = std::max(address, mBaseAddress);
+  uintptr_t end = std::min(address + size, mBaseAddress + mSize);
+
+  if(start >= end) {
+    return;
+  }
+
+  for(uintptr_t offset = start - mBaseAddress; offset < (end - mBaseAddress); offset++) {
+    mBits[offset / 64] |= uint64_t(1) << (offset % 64);
+  }
+
+  mCount++;
+}
+
+uintptr_t RelocationMap::FindNext(uintptr_t start, uintptr_t end) const {
+  start = std::max(start, mBaseAddress);
+  end = std::min(end, mBaseAddress + mSize);
+
+  if(start >= end) {
+    return 0;
+  }
+
+  size_t offset = start - mBaseAddress;
+  const size_t limit = end - mBaseAddress;
+
+  // Discard the bits below the start in the first word
+  uint64_t word = mBits[offset / 64] & (~uint64_t(0) << (offset % 64));
+  offset &= ~size_t(63);
+
+  for(;;) {
+    if(word != 0) {
+      offset += Bits::CountTrailingZeros(word);
+      return offset < limit ? mBaseAddress + offset : 0;
+    }
+
+    offset += 64;
+    if(offset >= limit) {
+      return 0;
+    }
+
+    word = mBits[offset / 64];
+  }
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
@@ -0,0 +1,45 @@
+#include <cassert>
+
+#include "Resolver.hpp"
+
+Resolver& Resolver::Offset(ptrdiff_t offset) {
+  Step step = { Step::Offset, offset, 0 };
+  mSteps.push_back(step);
+  return *this;
+}
+
+Resolver& Resolver::Relative8(size_t operand, size_t length) {
+  assert((operand + sizeof(int8_t)) <= length);
+
+  Step step = { Step::Relative8, static_cast<ptrdiff_t>(operand), length };
+  mSteps.push_back(step);
+  return *this;
+}
+
+Resolver& Resolver::Relative32(size_t operand, size_t length) {
+  assert((operand + sizeof(int32_t)) <= length);
+
+  Step step = { Step::Relative32, static_cast<ptrdiff_t>(operand), length };
+  mSteps.push_back(step);
+  return *this;
+}
+
+Resolver& Resolver::Dereference() {
+  Step step = { Step::Dereference, 0, 0 };
+  mSteps.push_back(step);
+  return *this;
+}
+
+bool Resolver::Resolve(
+    uintptr_t address,
+    uintptr_t lower,
+    uintptr_t upper,
+    uintptr_t* result) const {
+  assert(result != nullptr);
+
+  return this->Resolve(address, [&](uintptr_t target, size_t size) {
+    return target >= lower && target <= upper && (upper - target) >= size;
+  }, result);
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
@@ -0,0 +1,259 @@
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <thread>
+#ifdef _WIN32
+# include <windows.h>
+#else /* POSIX */
+# include <cerrno>
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+#include "ResultCache.hpp"
+
+struct ResultCache::Slot {
+  /* The key of the result, or zero if the slot is free */
+  std::atomic<uint64_t> key;
+
+  /* The stored value (see <EncodeOffset>), or zero if not yet published */
+  std::atomic<uint64_t> value;
+};
+
+namespace {
+/* Identifies an initialized table, written last by its creator */
+const uint64_t Magic = 0x3148434152435353ull;
+const uint64_t Version = 1;
+
+/* Precedes the slots of the table */
+struct Header {
+  std::atomic<uint64_t> magic;
+  uint64_t version;
+  uint64_t capacity;
+  uint64_t reserved;
+};
+
+/* The time to wait for another process to initialize a table */
+const std::chrono::seconds InitializationTimeout(1);
+
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t),
+  "shared atomics must have the layout of their value");
+
+/* Encode an offset as a (non-zero) slot value */
+uint64_t EncodeOffset(size_t offset) {
+  return offset == ResultCache::npos ? UINT64_MAX : static_cast<uint64_t>(offset) + 1;
+}
+
+/* Decode a (non-zero) slot value as an offset */
+size_t DecodeOffset(uint64_t value) {
+  return value == UINT64_MAX ? ResultCache::npos : static_cast<size_t>(value - 1);
+}
+
+/* Get the size of a segment holding a table */
+size_t GetSegmentSize(size_t capacity) {
+  return sizeof(Header) + capacity * sizeof(uint64_t) * 2;
+}
+
+#ifndef _WIN32
+/* Get the name of a POSIX shared memory object */
+std::string GetObjectName(const std::string& name) {
+  return name.empty() || name[0] != '/' ? '/' + name : name;
+}
+#endif
+}
+
+const size_t ResultCache::npos;
+const size_t ResultCache::DefaultCapacity;
+
+ResultCache::ResultCache(const std::string& name, size_t capacity /*= DefaultCapacity*/) :
+    mSlots(nullptr),
+    mCapacity(1)
+{
+  assert(capacity > 0 && capacity <= (SIZE_MAX >> 8));
+  assert(std::atomic<uint64_t>().is_lock_free());
+
+  while(mCapacity < capacity) {
+    mCapacity <<= 1;
+  }
+
+  size_t size = GetSegmentSize(mCapacity);
+  bool created;
+
+#ifdef _WIN32
+  HANDLE mapping = CreateFileMappingA(
+    INVALID_HANDLE_VALUE,
+    nullptr,
+    PAGE_READWRITE,
+    static_cast<DWORD>(static_cast<uint64_t>(size) >> 32),
+    static_cast<DWORD>(size),
+    ("Local\\" + name).c_str());
+
+  if(mapping == nullptr) {
+    throw Exception("couldn't create result cache");
+  }
+
+  created = GetLastError() != ERROR_ALREADY_EXISTS;
+  void* view = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+  CloseHandle(mapping);
+
+  if(view == nullptr) {
+    throw Exception("couldn't map result cache");
+  }
+
+  MEMORY_BASIC_INFORMATION information;
+  VirtualQuery(view, &information, sizeof(information));
+  size = information.RegionSize;
+
+  mMapping.reset(view, +[](void* address) {
+    UnmapViewOfFile(address);
+  });
+#else /* POSIX */
+  const std::string object = GetObjectName(name);
+  int file = -1;
+
+  for(int attempt = 0; file < 0 && attempt < 2; attempt++) {
+    file = shm_open(object.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+    created = file >= 0;
+
+    if(created && ftruncate(file, size) != 0) {
+      close(file);
+      shm_unlink(object.c_str());
+      throw Exception("couldn't create result cache");
+    }
+
+    if(!created && errno == EEXIST) {
+      file = shm_open(object.c_str(), O_RDWR | O_CLOEXEC, 0600);
+    }
+
+    if(file < 0) {
+      throw Exception("couldn't open result cache");
+    }
+
+    // The creator sizes the segment right after creating it
+    const auto deadline = std::chrono::steady_clock::now() + InitializationTimeout;
+    struct stat status;
+
+    while(!created && fstat(file, &status) == 0 && status.st_size == 0 &&
+        std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::yield();
+    }
+
+    if(!created) {
+      const size_t existing = fstat(file, &status) == 0 ? static_cast<size_t>(status.st_size) : 0;
+
+      // A segment still empty was abandoned by a creator that died before
+      // sizing it; it is removed and created anew (once)
+      if(existing == 0 && attempt == 0) {
+        close(file);
+        shm_unlink(object.c_str());
+        file = -1;
+        continue;
+      }
+
+      size = existing;
+    }
+  }
+
+  void* view = size >= sizeof(Header) ?
+    mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0) : MAP_FAILED;
+  close(file);
+
+  if(view == MAP_FAILED) {
+    throw Exception("couldn't map result cache");
+  }
+
+  mMapping.reset(view, [size](void* address) {
+    munmap(address, size);
+  });
+#endif
+
+  Header* header = static_cast<Header*>(mMapping.get());
+
+  if(created) {
+    header->version = Version;
+    header->capacity = mCapacity;
+    header->magic.store(Magic, std::memory_order_release);
+  } else {
+    const auto deadline = std::chrono::steady_clock::now() + InitializationTimeout;
+
+    while(header->magic.load(std::memory_order_acquire) != Magic &&
+        std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::yield();
+    }
+
+    const uint64_t existing = header->capacity;
+
+    if(header->magic.load(std::memory_order_acquire) != Magic ||
+        header->version != Version ||
+        existing == 0 ||
+        (existing & (existing - 1)) != 0 ||
+        existing > (size - sizeof(Header)) / (sizeof(uint64_t) * 2)) {
+      throw Exception("invalid result cache");
+    }
+
+    mCapacity = static_cast<size_t>(existing);
+  }
+
+  mSlots = reinterpret_cast<Slot*>(header + 1);
+}
+
+bool ResultCache::Find(uint64_t key, size_t* offset) const {
+  assert(key != 0);
+  assert(offset != nullptr);
+
+  for(size_t i = 0; i < mCapacity; i++) {
+    const Slot& slot = mSlots[(key + i) & (mCapacity - 1)];
+    const uint64_t current = slot.key.load(std::memory_order_acquire);
+
+    if(current == 0) {
+      return false;
+    }
+
+    if(current == key) {
+      const uint64_t value = slot.value.load(std::memory_order_acquire);
+
+      if(value == 0) {
+        return false;
+      }
+
+      *offset = DecodeOffset(value);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool ResultCache::Insert(uint64_t key, size_t offset) {
+  assert(key != 0);
+
+  for(size_t i = 0; i < mCapacity; i++) {
+    Slot& slot = mSlots[(key + i) & (mCapacity - 1)];
+    uint64_t current = slot.key.load(std::memory_order_acquire);
+
+    // A free slot is claimed, unless another process claims it first
+    if(current == 0 && slot.key.compare_exchange_strong(current, key, std::memory_order_acq_rel)) {
+      current = key;
+    }
+
+    if(current == key) {
+      slot.value.store(EncodeOffset(offset), std::memory_order_release);
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool ResultCache::Remove(const std::string& name) {
+#ifdef _WIN32
+  (void)name;
+  return true;
+#else /* POSIX */
+  return shm_unlink(GetObjectName(name).c_str()) == 0 || errno == ENOENT;
+#endif
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
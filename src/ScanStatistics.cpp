@@ -0,0 +1,122 @@
+#include <algorithm>
+#include <sstream>
+
+#include "ScanStatistics.hpp"
+
+namespace {
+/* The counters of the last search on each thread */
+thread_local ScanStatistics::Counters LastScan;
+}
+
+ScanStatistics::Counters::Counters() :
+    bytesScanned(0),
+    regionsVisited(0),
+    regionsSkipped(0),
+    regionLookupNanoseconds(0),
+    candidates(0),
+    verifications(0),
+    matches(0)
+{
+}
+
+ScanStatistics::Counters& ScanStatistics::Counters::operator+=(const Counters& other) {
+  bytesScanned += other.bytesScanned;
+  regionsVisited += other.regionsVisited;
+  regionsSkipped += other.regionsSkipped;
+  regionLookupNanoseconds += other.regionLookupNanoseconds;
+  candidates += other.candidates;
+  verifications += other.verifications;
+  matches += other.matches;
+  return *this;
+}
+
+ScanStatistics::Latency::Latency() :
+    count(0),
+    totalNanoseconds(0),
+    maxNanoseconds(0),
+    histogram()
+{
+}
+
+void ScanStatistics::Record(const Counters& counters) {
+  std::lock_guard<std::mutex> lock(mMutex);
+  mCounters += counters;
+}
+
+void ScanStatistics::RecordLatency(const std::string& signature, uint64_t nanoseconds) {
+  size_t bucket = 0;
+  for(uint64_t microseconds = nanoseconds / 1000; microseconds > 0; microseconds >>= 1) {
+    bucket++;
+  }
+
+  std::lock_guard<std::mutex> lock(mMutex);
+  Latency& latency = mLatencies[signature];
+
+  latency.count++;
+  latency.totalNanoseconds += nanoseconds;
+  latency.maxNanoseconds = std::max(latency.maxNanoseconds, nanoseconds);
+  latency.histogram[std::min(bucket, HistogramSize - 1)]++;
+}
+
+ScanStatistics::Counters ScanStatistics::GetCounters() const {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mCounters;
+}
+
+std::map<std::string, ScanStatistics::Latency> ScanStatistics::GetLatencies() const {
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mLatencies;
+}
+
+void ScanStatistics::Reset() {
+  std::lock_guard<std::mutex> lock(mMutex);
+  mCounters = Counters();
+  mLatencies.clear();
+}
+
+std::string ScanStatistics::ToJson() const {
+  const Counters counters = this->GetCounters();
+  const std::map<std::string, Latency> latencies = this->GetLatencies();
+  std::ostringstream json;
+
+  json << "{\"bytesScanned\":" << counters.bytesScanned
+       << ",\"regionsVisited\":" << counters.regionsVisited
+       << ",\"regionsSkipped\":" << counters.regionsSkipped
+       << ",\"regionLookupNanoseconds\":" << counters.regionLookupNanoseconds
+       << ",\"candidates\":" << counters.candidates
+       << ",\"verifications\":" << counters.verifications
+       << ",\"matches\":" << counters.matches
+       << ",\"signatures\":[";
+
+  // Signature patterns consist of hex digits, wildcards and ampersands, so
+  // they never require escaping.
+  for(auto it = latencies.begin(); it != latencies.end(); ++it) {
+    const Latency& latency = it->second;
+
+    json << ((it == latencies.begin()) ? "" : ",")
+         << "{\"signature\":\"" << it->first << "\""
+         << ",\"count\":" << latency.count
+         << ",\"totalNanoseconds\":" << latency.totalNanoseconds
+         << ",\"maxNanoseconds\":" << latency.maxNanoseconds
+         << ",\"histogram\":[";
+
+    for(size_t i = 0; i < HistogramSize; i++) {
+      json << ((i == 0) ? "" : ",") << latency.histogram[i];
+    }
+
+    json << "]}";
+  }
+
+  json << "]}";
+  return json.str();
+}
+
+ScanStatistics::Counters ScanStatistics::GetLastScan() {
+  return LastScan;
+}
+
+void ScanStatistics::SetLastScan(const Counters& counters) {
+  LastScan = counters;
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
@@ -0,0 +1,51 @@
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+#include "SelectivityReport.hpp"
+
+SelectivityReport::SelectivityReport() :
+    anchorIndex(0),
+    anchorLength(0),
+    anchorHits(0),
+    matches(0),
+    nanoseconds(0),
+    timeShare(0.0),
+    suggestedAnchorIndex(0),
+    suggestedAnchorLength(0),
+    suggestedAnchorHits(0)
+{
+}
+
+std::string SelectivityReport::ToString() const {
+  std::ostringstream report;
+
+  report << signature << "\n"
+         << "  time: " << nanoseconds << " ns (" << (timeShare * 100.0) << "%)\n"
+         << "  anchor: [" << anchorIndex << ", " << (anchorIndex + anchorLength)
+         << "), " << anchorHits << " hits, " << matches << " matches\n";
+
+  auto worst = std::max_element(failures.begin(), failures.end());
+  if(worst != failures.end() && *worst > 0) {
+    report << "  most failures at byte " << (worst - failures.begin())
+           << " (" << *worst << " of " << (anchorHits - matches) << ")\n";
+  }
+
+  if(suggestedAnchorLength > 0 && suggestedAnchorHits < anchorHits &&
+      (suggestedAnchorIndex != anchorIndex || suggestedAnchorLength != anchorLength)) {
+    report << "  suggestion: anchor on [" << suggestedAnchorIndex << ", "
+           << (suggestedAnchorIndex + suggestedAnchorLength) << "), about "
+           << suggestedAnchorHits << " hits\n";
+  }
+
+  for(const std::pair<size_t, byte>& tightening : tightenings) {
+    char value[3];
+    snprintf(value, sizeof(value), "%02X", tightening.second);
+
+    report << "  suggestion: byte " << tightening.first << " is always " << value << "\n";
+  }
+
+  return report.str();
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
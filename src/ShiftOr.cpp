@@ -0,0 +1,47 @@
+#include <cassert>
+
+#include "ShiftOr.hpp"
+
+const size_t ShiftOr::MaxSize;
+
+ShiftOr::ShiftOr(const Signature& signature) :
+    mAccept(1ull << (signature.GetSize() - 1)),
+    mSize(signature.GetSize())
+{
+  assert(mSize > 0 && mSize <= MaxSize);
+
+  const byte* values = signature.GetValues();
+  const byte* masks = signature.GetMasks();
+
+  for(size_t value = 0; value < 256; value++) {
+    mMasks[value] = ~0ull;
+
+    for(size_t i = 0; i < mSize; i++) {
+      if((value & masks[i]) == values[i]) {
+        mMasks[value] &= ~(1ull << i);
+      }
+    }
+  }
+}
+
+const byte* ShiftOr::Find(const byte* begin, const byte* end) const {
+  if(static_cast<size_t>(end - begin) < mSize) {
+    return nullptr;
+  }
+
+  // A bit can only be cleared after as many bytes as its position, so the
+  // initial state never yields a match starting before the block.
+  uint64_t state = ~0ull;
+
+  for(const byte* position = begin; position < end; position++) {
+    state = (state << 1) | mMasks[*position];
+
+    if((state & mAccept) == 0) {
+      return position - mSize + 1;
+    }
+  }
+
+  return nullptr;
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
@@ -0,0 +1,347 @@
+#include <cassert>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
+
+#include "Cpu.hpp"
+#include "Signature.hpp"
+
+namespace {
+/* Parse a single hex digit or wildcard into its value and mask nibbles */
+bool ParseNibble(char digit, byte* value, byte* mask) {
+  if(digit == '?') {
+    *value = 0;
+    *mask = 0;
+  } else if(isxdigit(static_cast<unsigned char>(digit))) {
+    *value = static_cast<byte>(isdigit(static_cast<unsigned char>(digit)) ?
+      digit - '0' : (tolower(static_cast<unsigned char>(digit)) - 'a') + 10);
+    *mask = 0xF;
+  } else {
+    return false;
+  }
+
+  return true;
+}
+
+/* Reads are only guaranteed to be safe within the page of the last byte */
+const uintptr_t PageSize = 4096;
+
+/* Get the number of bytes compared by the AVX2 verification */
+size_t GetVectorLength(size_t size) {
+  return (size <= 32) ? 32 : 64;
+}
+
+#if SCANNER_X86_DISPATCH
+SCANNER_TARGET("avx512f,avx512bw")
+bool MatchesAvx512(const byte* data, size_t size, const byte* values, const byte* masks) {
+  // Masked out lanes are neither read (nor faulted on) nor compared
+  const __mmask64 lanes = (size == 64) ? ~0ull : ((1ull << size) - 1);
+  const __m512i source = _mm512_maskz_loadu_epi8(lanes, data);
+
+  return _mm512_cmpneq_epi8_mask(
+    _mm512_and_si512(source, _mm512_loadu_si512(masks)),
+    _mm512_loadu_si512(values)) == 0;
+}
+
+SCANNER_TARGET("avx2")
+bool MatchesAvx2(const byte* source, size_t length, const byte* values, const byte* masks) {
+  for(size_t i = 0; i < length; i += 32) {
+    const __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i));
+    const __m256i mask = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(masks + i));
+    const __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + i));
+
+    if(_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(data, mask), value)) != -1) {
+      return false;
+    }
+  }
+
+  return true;
+}
+#endif
+
+/* Parse two hex digits (or wildcards) into a value and mask */
+bool ParseByte(const std::string& token, byte* value, byte* mask) {
+  byte upperValue, upperMask, lowerValue, lowerMask;
+
+  if(token.size() != 2 ||
+      !ParseNibble(token[0], &upperValue, &upperMask) ||
+      !ParseNibble(token[1], &lowerValue, &lowerMask)) {
+    return false;
+  }
+
+  *value = static_cast<byte>((upperValue << 4) | lowerValue);
+  *mask = static_cast<byte>((upperMask << 4) | lowerMask);
+  return true;
+}
+}
+
+Signature::Signature(const std::vector<byte>& values, const char* mask) :
+    mAlignment(1),
+    mAlignmentRemainder(0)
+{
+  assert(mask != nullptr);
+  assert(values.size() == strlen(mask));
+
+  this->Assign(values.data(), mask, values.size());
+}
+
+Signature::Signature(
+    const std::vector<byte>& values,
+    const std::vector<byte>& masks) :
+    mAlignment(1),
+    mAlignmentRemainder(0)
+{
+  if(values.size() != masks.size()) {
+    throw Exception("signature values and masks differ in length");
+  }
+
+  this->Assign(values.data(), masks.data(), values.size());
+}
+
+Signature::Signature(const byte* values, const char* mask, size_t size) :
+    mAlignment(1),
+    mAlignmentRemainder(0)
+{
+  assert(values != nullptr || size == 0);
+  assert(mask != nullptr || size == 0);
+
+  this->Assign(values, mask, size);
+}
+
+Signature::Signature(const byte* values, const byte* masks, size_t size) :
+    mAlignment(1),
+    mAlignmentRemainder(0)
+{
+  assert(values != nullptr || size == 0);
+  assert(masks != nullptr || size == 0);
+
+  this->Assign(values, masks, size);
+}
+
+Signature::Signature(const byte* values, const uint64_t* bitmap, size_t size) :
+    mAlignment(1),
+    mAlignmentRemainder(0)
+{
+  assert(values != nullptr || size == 0);
+  assert(bitmap != nullptr || size == 0);
+
+  this->Reserve(size);
+  byte* targetValues = this->GetMutableValues();
+  byte* targetMasks = this->GetMutableMasks();
+
+  for(size_t i = 0; i < size; i++) {
+    targetValues[i] = values[i];
+    targetMasks[i] = ((bitmap[i / 64] >> (i % 64)) & 1) ? 0xFF : 0x00;
+  }
+
+  this->PrepareVectors();
+}
+
+Signature::Signature(const std::string& pattern) :
+    mAlignment(1),
+    mAlignmentRemainder(0)
+{
+  std::istringstream stream(pattern);
+  std::vector<byte> values, masks;
+  std::string token;
+
+  while(stream >> token) {
+    byte value = 0, mask = 0;
+
+    if(token == "?") {
+      // A single wildcard ignores the entire byte
+    } else if(token.size() == 5 && token[2] == '&') {
+      byte explicitMask, explicitMaskMask;
+
+      // Wildcards are allowed in the value, but not in the explicit mask
+      if(!ParseByte(token.substr(0, 2), &value, &mask) ||
+          !ParseByte(token.substr(3, 2), &explicitMask, &explicitMaskMask) ||
+          explicitMaskMask != 0xFF) {
+        throw Exception("malformed signature byte '" + token + "'");
+      }
+
+      mask &= explicitMask;
+    } else if(!ParseByte(token, &value, &mask)) {
+      throw Exception("malformed signature byte '" + token + "'");
+    }
+
+    values.push_back(value);
+    masks.push_back(mask);
+  }
+
+  if(values.empty()) {
+    throw Exception("empty signature pattern");
+  }
+
+  this->Assign(values.data(), masks.data(), values.size());
+}
+
+void Signature::SetAlignment(size_t alignment, size_t remainder /*= 0*/) {
+  if(alignment == 0 || remainder >= alignment) {
+    throw Exception("invalid signature alignment");
+  }
+
+  mAlignment = alignment;
+  mAlignmentRemainder = remainder;
+}
+
+void Signature::Reserve(size_t size) {
+  mSize = size;
+
+  memset(mForwardValues, 0, sizeof(mForwardValues));
+  memset(mForwardMasks, 0, sizeof(mForwardMasks));
+  memset(mBackwardValues, 0, sizeof(mBackwardValues));
+  memset(mBackwardMasks, 0, sizeof(mBackwardMasks));
+
+  // Small signatures are stored inline, without any allocations
+  if(size > MaxVectorSize) {
+    mValues.assign(size, 0);
+    mMasks.assign(size, 0);
+  } else {
+    mValues.clear();
+    mMasks.clear();
+  }
+}
+
+byte* Signature::GetMutableValues() {
+  return (mSize > MaxVectorSize) ? mValues.data() : mForwardValues;
+}
+
+byte* Signature::GetMutableMasks() {
+  return (mSize > MaxVectorSize) ? mMasks.data() : mForwardMasks;
+}
+
+void Signature::Assign(const byte* values, const char* mask, size_t size) {
+  this->Reserve(size);
+  byte* targetValues = this->GetMutableValues();
+  byte* targetMasks = this->GetMutableMasks();
+
+  for(size_t i = 0; i < size; i++) {
+    targetValues[i] = values[i];
+    targetMasks[i] = (mask[i] == '?') ? 0x00 : 0xFF;
+  }
+
+  this->PrepareVectors();
+}
+
+void Signature::Assign(const byte* values, const byte* masks, size_t size) {
+  this->Reserve(size);
+  byte* targetValues = this->GetMutableValues();
+  byte* targetMasks = this->GetMutableMasks();
+
+  if(size > 0) {
+    memcpy(targetValues, values, size);
+    memcpy(targetMasks, masks, size);
+  }
+
+  this->PrepareVectors();
+}
+
+void Signature::PrepareVectors() {
+  byte* values = this->GetMutableValues();
+  const byte* masks = this->GetMutableMasks();
+
+  // Values are stored with the masked out bits cleared
+  for(size_t i = 0; i < mSize; i++) {
+    values[i] &= masks[i];
+  }
+
+  if(mSize == 0 || mSize > MaxVectorSize) {
+    return;
+  }
+
+  const size_t padding = GetVectorLength(mSize) - mSize;
+
+  memcpy(mBackwardValues + padding, mForwardValues, mSize);
+  memcpy(mBackwardMasks + padding, mForwardMasks, mSize);
+}
+
+bool Signature::Matches(const byte* data) const {
+  assert(data != nullptr);
+
+  const size_t size = mSize;
+  const byte* values = this->GetValues();
+  const byte* masks = this->GetMasks();
+  size_t i = 0;
+
+#if SCANNER_X86_DISPATCH
+  if(size > 0 && size <= MaxVectorSize) {
+    if(Cpu::HasAvx512()) {
+      return MatchesAvx512(data, size, mForwardValues, mForwardMasks);
+    }
+
+    if(Cpu::HasAvx2()) {
+      // The vector is read forward from the data, unless that would cross
+      // into the page after the last byte, in which case it is read
+      // backward from the last byte (which stays within the page).
+      const size_t length = GetVectorLength(size);
+      const uintptr_t last = reinterpret_cast<uintptr_t>(data) + size - 1;
+      const uintptr_t forward = reinterpret_cast<uintptr_t>(data) + length - 1;
+
+      return ((last / PageSize) == (forward / PageSize)) ?
+        MatchesAvx2(data, length, mForwardValues, mForwardMasks) :
+        MatchesAvx2(data + size - length, length, mBackwardValues, mBackwardMasks);
+    }
+  }
+#endif
+
+#ifdef __SSE2__
+  for(; (i + 16) <= size; i += 16) {
+    const __m128i source = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+    const __m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(masks + i));
+    const __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(values + i));
+
+    if(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(source, mask), value)) != 0xFFFF) {
+      return false;
+    }
+  }
+#endif
+
+  for(; i < size; i++) {
+    if((data[i] & masks[i]) != values[i]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+std::string Signature::ToString() const {
+  static const char digits[] = "0123456789ABCDEF";
+  std::string pattern;
+
+  for(size_t i = 0; i < mSize; i++) {
+    if(i > 0) {
+      pattern += ' ';
+    }
+
+    const byte value = this->GetValues()[i];
+    const byte mask = this->GetMasks()[i];
+
+    if(mask == 0x00) {
+      pattern += '?';
+      continue;
+    }
+
+    // Nibbles are either compared in their entirety or ignored
+    const bool upper = (mask & 0xF0) == 0xF0 || (mask & 0xF0) == 0;
+    const bool lower = (mask & 0x0F) == 0x0F || (mask & 0x0F) == 0;
+
+    pattern += (mask & 0xF0) ? digits[value >> 4] : '?';
+    pattern += (mask & 0x0F) ? digits[value & 0xF] : '?';
+
+    if(!upper || !lower) {
+      pattern += '&';
+      pattern += digits[mask >> 4];
+      pattern += digits[mask & 0xF];
+    }
+  }
+
+  return pattern;
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
@@ -0,0 +1,59 @@
+#include <new>
+#include <type_traits>
+
+#include "AnchorSearch.hpp"
+#include "SignatureEngine.hpp"
+
+static_assert(std::is_trivially_destructible<ShiftOr>::value &&
+    std::is_trivially_destructible<Stride>::value,
+  "engines held in place must not require destruction");
+
+SignatureEngine::SignatureEngine(
+    const Signature& signature,
+    const ByteProfile* profile /*= nullptr*/,
+    const RelocationMap* relocations /*= nullptr*/) :
+    mSignature(signature),
+    mRelocations(relocations),
+    mAnchorIndex(0),
+    mAnchorLength(0),
+    mMethod(AnchorMethod)
+{
+  const AnchorSearch::Anchor anchor = AnchorSearch::SelectAnchor(
+    mSignature,
+    profile ? *profile : ByteProfile::GetStaticProfile());
+
+  mAnchorIndex = anchor.index;
+  mAnchorLength = anchor.length;
+
+  // Short signatures without a selective anchor (e.g mostly wildcards) are
+  // searched bit-parallel instead, and aligned signatures only at eligible
+  // positions, unless relocated bytes are ignored.
+  if(mRelocations != nullptr || mSignature.GetSize() == 0) {
+    return;
+  }
+
+  if(mSignature.GetAlignment() > 1) {
+    new(&mStride) Stride(mSignature);
+    mMethod = StrideMethod;
+  } else if(mSignature.GetSize() <= ShiftOr::MaxSize &&
+      anchor.frequency >= AnchorSearch::ShiftOrThreshold) {
+    new(&mShiftOr) ShiftOr(mSignature);
+    mMethod = ShiftOrMethod;
+  }
+}
+
+const byte* SignatureEngine::Find(
+    const byte* begin,
+    const byte* end,
+    ScanStatistics::Counters* counters /*= nullptr*/) const {
+  switch(mMethod) {
+  case StrideMethod: return mStride.Find(begin, end, counters);
+  case ShiftOrMethod: return mShiftOr.Find(begin, end);
+  case AnchorMethod: break;
+  }
+
+  const AnchorSearch::Anchor anchor = { mAnchorIndex, mAnchorLength, 0.0 };
+  return AnchorSearch::FindInBlock(begin, end, mSignature, anchor, mRelocations, counters);
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
@@ -0,0 +1,385 @@
+#include <cassert>
+#include <cstring>
+#include <ostream>
+#ifdef _WIN32
+# include <windows.h>
+#else /* POSIX */
+# include <fcntl.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <unistd.h>
+#endif
+
+#include "Fnv.hpp"
+#include "SignaturePack.hpp"
+
+namespace {
+/* Identifies a pack, followed by its format version */
+const char Magic[4] = { 'S', 'S', 'P', 'K' };
+
+/* The layout of the file
+ *
+ * Header: the magic, the version (32 bits), the checksum of every byte that
+ * follows it (see <SignaturePack::Verify>), and the number of signatures.
+ *
+ * Record (one per signature): the offset and length of its name, the
+ * offset of its values (directly followed by its masks), its size, its
+ * alignment and remainder, and the offset and number of its steps.
+ *
+ * Step: the type, value and length of a resolver step.
+ */
+const size_t HeaderSize = 24;
+const size_t ChecksumOffset = 8;
+const size_t RecordSize = 64;
+const size_t StepSize = 24;
+
+/* The fields of a record */
+enum RecordField {
+  NameOffset,
+  NameLength,
+  ValuesOffset,
+  SignatureSize,
+  Alignment,
+  AlignmentRemainder,
+  StepsOffset,
+  StepCount,
+};
+
+/* Read a value in little endian byte order */
+uint64_t ReadValue(const byte* position, size_t size = 8) {
+  uint64_t value = 0;
+
+  for(size_t i = 0; i < size; i++) {
+    value |= static_cast<uint64_t>(position[i]) << (i * 8);
+  }
+
+  return value;
+}
+
+/* Write a value in little endian byte order, at a position of a buffer */
+void WriteValue(std::string* buffer, size_t position, uint64_t value, size_t size = 8) {
+  assert((position + size) <= buffer->size());
+
+  for(size_t i = 0; i < size; i++) {
+    (*buffer)[position + i] = static_cast<char>(value >> (i * 8));
+  }
+}
+
+/* Pad a buffer with zeroes to a multiple of eight bytes */
+void Align(std::string* buffer) {
+  buffer->resize((buffer->size() + 7) & ~static_cast<size_t>(7));
+}
+
+/* Check if a range lies within a block of memory, without overflowing */
+bool IsInRange(uint64_t offset, uint64_t length, size_t size) {
+  return offset <= size && length <= (size - offset);
+}
+
+/* Compute the checksum (a 64-bit FNV-1a hash) of a block of memory */
+uint64_t Checksum(const byte* data, size_t size) {
+  return Fnv::HashBytes(Fnv::Basis, data, size);
+}
+}
+
+const uint32_t SignaturePack::Version;
+const size_t SignaturePack::npos;
+
+SignaturePack::SignaturePack(const std::string& path) :
+    mData(nullptr),
+    mSize(0),
+    mCount(0)
+{
+#ifdef _WIN32
+  HANDLE file = CreateFileA(
+    path.c_str(),
+    GENERIC_READ,
+    FILE_SHARE_READ,
+    nullptr,
+    OPEN_EXISTING,
+    FILE_ATTRIBUTE_NORMAL,
+    nullptr);
+
+  if(file == INVALID_HANDLE_VALUE) {
+    throw Exception("couldn't open signature pack");
+  }
+
+  LARGE_INTEGER size;
+  HANDLE mapping = GetFileSizeEx(file, &size) && size.QuadPart >= HeaderSize ?
+    CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+  CloseHandle(file);
+
+  if(mapping == nullptr) {
+    throw Exception("couldn't map signature pack");
+  }
+
+  void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+
+  if(view == nullptr) {
+    throw Exception("couldn't map signature pack");
+  }
+
+  mMapping.reset(view, +[](const void* address) {
+    UnmapViewOfFile(address);
+  });
+  mSize = static_cast<size_t>(size.QuadPart);
+#else /* POSIX */
+  int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+  if(file < 0) {
+    throw Exception("couldn't open signature pack");
+  }
+
+  struct stat status;
+  void* view = fstat(file, &status) == 0 && status.st_size >= static_cast<off_t>(HeaderSize) ?
+    mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED;
+  close(file);
+
+  if(view == MAP_FAILED) {
+    throw Exception("couldn't map signature pack");
+  }
+
+  const size_t size = static_cast<size_t>(status.st_size);
+  mMapping.reset(view, [size](const void* address) {
+    munmap(const_cast<void*>(address), size);
+  });
+  mSize = size;
+#endif
+
+  mData = static_cast<const byte*>(mMapping.get());
+  this->Validate();
+}
+
+SignaturePack::SignaturePack(const void* data, size_t size) :
+    mData(static_cast<const byte*>(data)),
+    mSize(size),
+    mCount(0)
+{
+  assert(data != nullptr || size == 0);
+  this->Validate();
+}
+
+void SignaturePack::Validate() {
+  if(mSize < HeaderSize || memcmp(mData, Magic, sizeof(Magic)) != 0) {
+    throw Exception("invalid signature pack");
+  }
+
+  const uint32_t version = static_cast<uint32_t>(
+    ReadValue(mData + sizeof(Magic), sizeof(uint32_t)));
+  if(version != Version) {
+    throw Exception("unsupported signature pack version " + std::to_string(version));
+  }
+
+  // The checksum is left to <Verify>, as it would read the whole pack
+  const size_t checked = ChecksumOffset + sizeof(uint64_t);
+  const uint64_t count = ReadValue(mData + checked);
+  if(count > (mSize - HeaderSize) / RecordSize) {
+    throw Exception("invalid signature pack");
+  }
+
+  mCount = static_cast<size_t>(count);
+
+  // Every view into the pack is validated once, so accessors need no checks
+  for(size_t i = 0; i < mCount; i++) {
+    const byte* record = this->GetRecord(i);
+    auto field = [&](RecordField index) { return ReadValue(record + index * 8); };
+
+    const uint64_t name = field(NameOffset);
+    const uint64_t size = field(SignatureSize);
+    const uint64_t alignment = field(Alignment);
+    const uint64_t steps = field(StepsOffset);
+    const uint64_t stepCount = field(StepCount);
+
+    if(!IsInRange(name, field(NameLength), mSize) ||
+        !IsInRange(name + field(NameLength), 1, mSize) ||
+        mData[name + field(NameLength)] != '\0' ||
+        size > mSize / 2 ||
+        !IsInRange(field(ValuesOffset), size * 2, mSize) ||
+        alignment == 0 ||
+        field(AlignmentRemainder) >= alignment ||
+        stepCount > mSize / StepSize ||
+        !IsInRange(steps, stepCount * StepSize, mSize)) {
+      throw Exception("invalid signature pack");
+    }
+
+    for(uint64_t j = 0; j < stepCount; j++) {
+      const byte* step = mData + steps + j * StepSize;
+      const uint64_t type = ReadValue(step);
+      const uint64_t operand = ReadValue(step + 8);
+      const uint64_t length = ReadValue(step + 16);
+
+      const bool valid =
+        type == Resolver::Step::Offset ||
+        type == Resolver::Step::Dereference ||
+        (type == Resolver::Step::Relative8 && operand < length) ||
+        (type == Resolver::Step::Relative32 && operand < length && (length - operand) >= 4);
+
+      if(!valid) {
+        throw Exception("invalid signature pack");
+      }
+    }
+  }
+}
+
+bool SignaturePack::Verify() const {
+  const size_t checked = ChecksumOffset + sizeof(uint64_t);
+  return ReadValue(mData + ChecksumOffset) == Checksum(mData + checked, mSize - checked);
+}
+
+const byte* SignaturePack::GetRecord(size_t index) const {
+  assert(index < mCount);
+  return mData + HeaderSize + index * RecordSize;
+}
+
+size_t SignaturePack::Find(const std::string& name) const {
+  for(size_t i = 0; i < mCount; i++) {
+    if(name == this->GetName(i)) {
+      return i;
+    }
+  }
+
+  return npos;
+}
+
+const char* SignaturePack::GetName(size_t index) const {
+  return reinterpret_cast<const char*>(
+    mData + ReadValue(this->GetRecord(index) + NameOffset * 8));
+}
+
+const byte* SignaturePack::GetValues(size_t index) const {
+  return mData + ReadValue(this->GetRecord(index) + ValuesOffset * 8);
+}
+
+const byte* SignaturePack::GetMasks(size_t index) const {
+  return this->GetValues(index) + this->GetSize(index);
+}
+
+size_t SignaturePack::GetSize(size_t index) const {
+  return static_cast<size_t>(ReadValue(this->GetRecord(index) + SignatureSize * 8));
+}
+
+Signature SignaturePack::GetSignature(size_t index) const {
+  const byte* record = this->GetRecord(index);
+  Signature signature(this->GetValues(index), this->GetMasks(index), this->GetSize(index));
+
+  const size_t alignment = static_cast<size_t>(ReadValue(record + Alignment * 8));
+  if(alignment > 1) {
+    signature.SetAlignment(
+      alignment,
+      static_cast<size_t>(ReadValue(record + AlignmentRemainder * 8)));
+  }
+
+  return signature;
+}
+
+Resolver SignaturePack::GetResolver(size_t index) const {
+  const byte* record = this->GetRecord(index);
+  const byte* steps = mData + ReadValue(record + StepsOffset * 8);
+  const uint64_t count = ReadValue(record + StepCount * 8);
+
+  Resolver resolver;
+
+  for(uint64_t i = 0; i < count; i++) {
+    const byte* step = steps + i * StepSize;
+    const uint64_t value = ReadValue(step + 8);
+    const size_t length = static_cast<size_t>(ReadValue(step + 16));
+
+    switch(static_cast<Resolver::Step::Type>(ReadValue(step))) {
+    case Resolver::Step::Offset:
+      resolver.Offset(static_cast<ptrdiff_t>(static_cast<int64_t>(value)));
+      break;
+    case Resolver::Step::Relative8:
+      resolver.Relative8(static_cast<size_t>(value), length);
+      break;
+    case Resolver::Step::Relative32:
+      resolver.Relative32(static_cast<size_t>(value), length);
+      break;
+    case Resolver::Step::Dereference:
+      resolver.Dereference();
+      break;
+    }
+  }
+
+  return resolver;
+}
+
+std::vector<Signature> SignaturePack::GetSignatures() const {
+  std::vector<Signature> signatures;
+  signatures.reserve(mCount);
+
+  for(size_t i = 0; i < mCount; i++) {
+    signatures.push_back(this->GetSignature(i));
+  }
+
+  return signatures;
+}
+
+std::vector<Resolver> SignaturePack::GetResolvers() const {
+  std::vector<Resolver> resolvers;
+  resolvers.reserve(mCount);
+
+  for(size_t i = 0; i < mCount; i++) {
+    resolvers.push_back(this->GetResolver(i));
+  }
+
+  return resolvers;
+}
+
+bool SignaturePack::Save(
+    std::ostream& stream,
+    const std::vector<std::string>& names,
+    const std::vector<Signature>& signatures,
+    const std::vector<Resolver>& resolvers) {
+  assert(names.size() == signatures.size());
+  assert(resolvers.size() == signatures.size());
+
+  std::string buffer(HeaderSize + signatures.size() * RecordSize, '\0');
+
+  for(size_t i = 0; i < signatures.size(); i++) {
+    const Signature& signature = signatures[i];
+    const std::vector<Resolver::Step>& steps = resolvers[i].GetSteps();
+    const size_t record = HeaderSize + i * RecordSize;
+
+    auto field = [&](RecordField index, uint64_t value) {
+      WriteValue(&buffer, record + index * 8, value);
+    };
+
+    field(NameOffset, buffer.size());
+    field(NameLength, names[i].size());
+    buffer.append(names[i].c_str(), names[i].size() + 1);
+    Align(&buffer);
+
+    field(ValuesOffset, buffer.size());
+    field(SignatureSize, signature.GetSize());
+    buffer.append(reinterpret_cast<const char*>(signature.GetValues()), signature.GetSize());
+    buffer.append(reinterpret_cast<const char*>(signature.GetMasks()), signature.GetSize());
+    Align(&buffer);
+
+    field(Alignment, signature.GetAlignment());
+    field(AlignmentRemainder, signature.GetAlignmentRemainder());
+    field(StepsOffset, buffer.size());
+    field(StepCount, steps.size());
+
+    for(const Resolver::Step& step : steps) {
+      const size_t position = buffer.size();
+      buffer.resize(position + StepSize);
+
+      WriteValue(&buffer, position, step.type);
+      WriteValue(&buffer, position + 8, static_cast<uint64_t>(static_cast<int64_t>(step.value)));
+      WriteValue(&buffer, position + 16, step.length);
+    }
+  }
+
+  const size_t checked = ChecksumOffset + sizeof(uint64_t);
+  memcpy(&buffer[0], Magic, sizeof(Magic));
+  WriteValue(&buffer, sizeof(Magic), Version, sizeof(uint32_t));
+  WriteValue(&buffer, checked, signatures.size());
+  WriteValue(&buffer, ChecksumOffset, Checksum(
+    reinterpret_cast<const byte*>(buffer.data()) + checked,
+    buffer.size() - checked));
+
+  stream.write(buffer.data(), buffer.size());
+  return static_cast<bool>(stream);
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
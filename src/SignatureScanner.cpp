@@ -1,139 +1,2204 @@
 #include <cassert>
+#include <cctype>
 #include <cstring>
 #include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <thread>
+#include <unordered_map>
 #include <vector>
 #ifdef _WIN32
 # include <windows.h>
 #else /* POSIX */
 # include <cstdio>
-# include <fstream>
 # include <sys/mman.h>
 # include <dlfcn.h>
+# include <link.h>
+# include <unistd.h>
 #endif
 
+#include "AnchorSearch.hpp"
+#include "Bits.hpp"
+#include "Fnv.hpp"
+#include "Probes.hpp"
+#include "ReferenceSearch.hpp"
+#include "SignatureEngine.hpp"
 #include "SignatureScanner.hpp"
+#include "Teddy.hpp"
 
 namespace {
 template<typename T, size_t Size>
 constexpr size_t GetArraySize(T(&)[Size]) { return Size; }
+
+/* Get the time elapsed since a point in time, in nanoseconds */
+uint64_t GetElapsedNanoseconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - start).count();
+}
+
+/* Get an identifier of a signature that is stable across searches and
+ * processes (a hash of its values and masks), e.g for probes */
+uint64_t GetSignatureId(const Signature& signature) {
+  const uint64_t hash = Fnv::HashBytes(Fnv::Basis, signature.GetValues(), signature.GetSize());
+  return Fnv::HashBytes(hash, signature.GetMasks(), signature.GetSize());
+}
+
+/* The amount of memory searched between cancellation checks */
+const size_t ChunkSize = 1 << 20;
+
+/* The smallest batch of signatures that is prefiltered */
+const size_t TeddyMinimumSignatures = 4;
+
+/* Create a signature matching a null-terminated string */
+Signature CreateStringSignature(
+    const std::string& text,
+    SignatureScanner::StringEncoding encoding) {
+  std::vector<byte> values;
+
+  for(char character : text) {
+    values.push_back(static_cast<byte>(character));
+
+    if(encoding == SignatureScanner::Utf16String) {
+      values.push_back(0);
+    }
+  }
+
+  values.insert(values.end(), (encoding == SignatureScanner::Utf16String) ? 2 : 1, 0);
+  return Signature(values, std::vector<byte>(values.size(), 0xFF));
+}
+
+#ifndef _WIN32
+/* Find a program header of an in-memory ELF module
+ *
+ * The load bias is derived from the first loadable segment. Throws if the
+ * module headers are invalid; returns null if no such header exists.
+ */
+const ElfW(Phdr)* FindProgramHeader(uintptr_t base, ElfW(Word) type, uintptr_t* bias) {
+  const ElfW(Ehdr)* header = reinterpret_cast<const ElfW(Ehdr)*>(base);
+
+  if(memcmp(header->e_ident, ELFMAG, SELFMAG) != 0) {
+    throw SignatureScanner::Exception("couldn't find module headers");
+  }
+
+  const ElfW(Phdr)* programHeaders =
+    reinterpret_cast<const ElfW(Phdr)*>(base + header->e_phoff);
+  const ElfW(Phdr)* result = nullptr;
+  bool foundLoad = false;
+
+  for(uint i = 0; i < header->e_phnum; i++) {
+    const ElfW(Phdr)& programHeader = programHeaders[i];
+
+    if(programHeader.p_type == PT_LOAD && !foundLoad) {
+      const uintptr_t pageSize = sysconf(_SC_PAGESIZE);
+
+      *bias = base - (programHeader.p_vaddr & ~(pageSize - 1));
+      foundLoad = true;
+    } else if(programHeader.p_type == type && result == nullptr) {
+      result = &programHeader;
+    }
+  }
+
+  return foundLoad ? result : nullptr;
+}
+
+/* Read the GNU build ID note of an in-memory ELF module
+ *
+ * Returns false if the module has no such note.
+ */
+bool ReadBuildId(uintptr_t base, const byte** id, size_t* size) {
+  uintptr_t bias = 0;
+  if(FindProgramHeader(base, PT_NOTE, &bias) == nullptr) {
+    return false;
+  }
+
+  const ElfW(Ehdr)* header = reinterpret_cast<const ElfW(Ehdr)*>(base);
+  const ElfW(Phdr)* programHeaders =
+    reinterpret_cast<const ElfW(Phdr)*>(base + header->e_phoff);
+
+  for(uint i = 0; i < header->e_phnum; i++) {
+    if(programHeaders[i].p_type != PT_NOTE) {
+      continue;
+    }
+
+    // Each note's name and description are padded to four bytes
+    const byte* note = reinterpret_cast<const byte*>(bias + programHeaders[i].p_vaddr);
+    const byte* end = note + programHeaders[i].p_memsz;
+
+    while((note + sizeof(ElfW(Nhdr))) <= end) {
+      const ElfW(Nhdr)* noteHeader = reinterpret_cast<const ElfW(Nhdr)*>(note);
+      const byte* name = note + sizeof(ElfW(Nhdr));
+      const byte* description = name + ((noteHeader->n_namesz + 3) & ~3u);
+
+      if(noteHeader->n_type == NT_GNU_BUILD_ID &&
+          noteHeader->n_namesz == 4 &&
+          memcmp(name, "GNU", 4) == 0) {
+        *id = description;
+        *size = noteHeader->n_descsz;
+        return true;
+      }
+
+      note = description + ((noteHeader->n_descsz + 3) & ~3u);
+    }
+  }
+
+  return false;
+}
+
+/* Read an unsigned LEB128 value, advancing the position past it */
+uint64_t ReadUleb128(const byte** position) {
+  uint64_t result = 0;
+  uint shift = 0;
+  byte value;
+
+  do {
+    value = *(*position)++;
+
+    if(shift < 64) {
+      result |= static_cast<uint64_t>(value & 0x7F) << shift;
+    }
+
+    shift += 7;
+  } while(value & 0x80);
+
+  return result;
+}
+
+/* Read a signed LEB128 value, advancing the position past it */
+int64_t ReadSleb128(const byte** position) {
+  uint64_t result = 0;
+  uint shift = 0;
+  byte value;
+
+  do {
+    value = *(*position)++;
+
+    if(shift < 64) {
+      result |= static_cast<uint64_t>(value & 0x7F) << shift;
+    }
+
+    shift += 7;
+  } while(value & 0x80);
+
+  if(shift < 64 && (value & 0x40)) {
+    result |= ~0ull << shift;
+  }
+
+  return static_cast<int64_t>(result);
+}
+
+/* Read a pointer encoded as in the unwind information ('DW_EH_PE_*')
+ *
+ * Advances the position past the value. Values relative to the data are
+ * relative to the supplied base (i.e '.eh_frame_hdr'); indirect values are
+ * not dereferenced. Returns false for unsupported encodings.
+ */
+bool ReadEncodedPointer(
+    const byte** position,
+    byte encoding,
+    uintptr_t dataBase,
+    uintptr_t* result) {
+  const uintptr_t origin = reinterpret_cast<uintptr_t>(*position);
+  uint64_t value = 0;
+
+  // The value format is described by the lower nibble
+  switch(encoding & 0x0F) {
+  case 0x00: value = *reinterpret_cast<const uintptr_t*>(*position); *position += sizeof(uintptr_t); break;
+  case 0x01: value = ReadUleb128(position); break;
+  case 0x02: value = *reinterpret_cast<const uint16_t*>(*position); *position += 2; break;
+  case 0x03: value = *reinterpret_cast<const uint32_t*>(*position); *position += 4; break;
+  case 0x04: value = *reinterpret_cast<const uint64_t*>(*position); *position += 8; break;
+  case 0x09: value = ReadSleb128(position); break;
+  case 0x0A: value = *reinterpret_cast<const int16_t*>(*position); *position += 2; break;
+  case 0x0B: value = *reinterpret_cast<const int32_t*>(*position); *position += 4; break;
+  case 0x0C: value = *reinterpret_cast<const int64_t*>(*position); *position += 8; break;
+  default: return false;
+  }
+
+  // The value application is described by the upper nibble
+  switch(encoding & 0x70) {
+  case 0x00: break;
+  case 0x10: value += origin; break;
+  case 0x30: value += dataBase; break;
+  default: return false;
+  }
+
+  *result = static_cast<uintptr_t>(value);
+  return true;
+}
+
+/* Get the encoding of the addresses of a common information entry's frames
+ *
+ * Returns false if the entry cannot be parsed.
+ */
+bool ReadFrameEncoding(const byte* entry, byte* encoding) {
+  const byte* position = entry + 4;
+
+  if(*reinterpret_cast<const uint32_t*>(entry) == 0xFFFFFFFF) {
+    position += 8;
+  }
+
+  // The entry's identifier is followed by its version and augmentation
+  position += 4;
+  const byte version = *position++;
+  const char* augmentation = reinterpret_cast<const char*>(position);
+  position += strlen(augmentation) + 1;
+
+  if(version >= 4) {
+    position += 2;
+  }
+
+  ReadUleb128(&position);
+  ReadSleb128(&position);
+
+  if(version == 1) {
+    position++;
+  } else {
+    ReadUleb128(&position);
+  }
+
+  *encoding = 0x00;
+
+  if(augmentation[0] != 'z') {
+    return augmentation[0] == '\0';
+  }
+
+  ReadUleb128(&position);
+
+  for(const char* type = augmentation + 1; *type != '\0'; type++) {
+    byte personalityEncoding;
+    uintptr_t personality;
+
+    switch(*type) {
+    case 'R': *encoding = *position++; break;
+    case 'L': position++; break;
+    case 'P':
+      personalityEncoding = *position++;
+
+      if(!ReadEncodedPointer(&position, personalityEncoding, 0, &personality)) {
+        return false;
+      }
+      break;
+    case 'S': case 'B': case 'G': break;
+    default: return false;
+    }
+  }
+
+  return true;
+}
+#endif
+
+/* Get the number of bytes within the supplied (sorted) ranges from an address */
+size_t GetReadableSize(
+    const std::vector<std::pair<uintptr_t, uintptr_t>>& readable,
+    uintptr_t address) {
+  auto range = std::upper_bound(
+    readable.begin(),
+    readable.end(),
+    std::make_pair(address, UINTPTR_MAX));
+
+  if(range == readable.begin()) {
+    return 0;
+  }
+
+  --range;
+  return (address < range->second) ? (range->second - address) : 0;
+}
+
+/* Read the mangled class name of an Itanium ABI type information object */
+bool ReadTypeName(
+    const std::vector<std::pair<uintptr_t, uintptr_t>>& readable,
+    uintptr_t typeInfo,
+    std::string* name) {
+  // The object consists of a virtual pointer followed by the name pointer
+  if((typeInfo % sizeof(uintptr_t)) != 0 ||
+      GetReadableSize(readable, typeInfo) < 2 * sizeof(uintptr_t)) {
+    return false;
+  }
+
+  const uintptr_t address = reinterpret_cast<const uintptr_t*>(typeInfo)[1];
+  const char* text = reinterpret_cast<const char*>(address);
+  size_t available = std::min<size_t>(GetReadableSize(readable, address), 1024);
+
+  // Types with internal linkage are prefixed with an asterisk
+  if(available > 0 && *text == '*') {
+    text++;
+    available--;
+  }
+
+  size_t length = 0;
+  while(length < available && (isalnum(static_cast<unsigned char>(text[length])) ||
+      text[length] == '_' || text[length] == '$' || text[length] == '.')) {
+    length++;
+  }
+
+  if(length == 0 || length == available || text[length] != '\0') {
+    return false;
+  }
+
+  // Class names begin with a length, or a nested, substituted or local name
+  if(!isdigit(static_cast<unsigned char>(text[0])) &&
+      text[0] != 'N' && text[0] != 'S' && text[0] != 'Z') {
+    return false;
+  }
+
+  name->assign(text, length);
+  return true;
+}
+
+/* Resolve a match, only permitting reads within the supplied ranges */
+bool ResolveMatch(
+    const Resolver& resolver,
+    const std::vector<std::pair<uintptr_t, uintptr_t>>& readable,
+    uintptr_t match,
+    uintptr_t* result) {
+  bool resolved = resolver.Resolve(match, [&](uintptr_t address, size_t size) {
+    const size_t available = GetReadableSize(readable, address);
+    return available > 0 && available >= size;
+  }, result);
+
+  // A null result is indistinguishable from no result at all
+  return resolved && *result != 0;
+}
+
+/* Find the first match of a signature within (sorted) regions
+ *
+ * The regions are clamped to [start, end). Each region is searched with a
+ * callable with the signature 'const byte*(const byte*, const byte*)',
+ * returning its first match or null. The module base and the signature are
+ * only passed to the probes.
+ */
+template<typename Find>
+uintptr_t FindFirstInRegions(
+    const std::vector<std::pair<uintptr_t, uintptr_t>>& regions,
+    uintptr_t start,
+    uintptr_t end,
+    uintptr_t base,
+    const Signature& signature,
+    Find find) {
+  (void)base;
+  (void)signature;
+
+  for(const std::pair<uintptr_t, uintptr_t>& region : regions) {
+    const uintptr_t lower = std::max(region.first, start);
+    const uintptr_t upper = std::min(region.second, end);
+
+    if(lower >= upper) {
+      continue;
+    }
+
+    const byte* begin = reinterpret_cast<const byte*>(lower);
+    const byte* limit = reinterpret_cast<const byte*>(upper);
+
+    SCANNER_PROBE(scan_start, base, begin, limit, 1);
+    Tracer::Scope regionScope("region", upper - lower);
+    const byte* match = find(begin, limit);
+    SCANNER_PROBE(scan_end, base, begin, limit, 1);
+
+    if(match != nullptr) {
+      SCANNER_PROBE(match, base, GetSignatureId(signature), match);
+      return reinterpret_cast<uintptr_t>(match);
+    }
+  }
+
+  return 0;
+}
+}
+
+SignatureScanner::SignatureScanner(void* containedAddress) :
+    mCache(std::make_shared<ModuleCache>()),
+    mBaseAddress(0),
+    mModuleSize(0)
+{
+  assert(containedAddress != nullptr);
+  Tracer::Scope scope("construct");
+
+#ifdef _WIN32
+  HMODULE module;
+  if(!GetModuleHandleEx(
+      GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS,
+      containedAddress)) {
+    throw Exception("couldn't retrieve memory module handle");
+  }
+
+  mModuleHandle.reset(module, +[](void* handle) {
+    if(handle != nullptr) { FreeLibrary(handle); }
+  });
+
+  MODULEINFO* moduleInfo;
+  if(!GetModuleInformation(
+      GetCurrentProcess(),
+      module,
+      &moduleInfo,
+      sizeof(MODULEINFO))) {
+    throw Exception("couldn't retrieve module information");
+  }
+
+  mBaseAddress  = reinterpret_cast<uintptr_t>(moduleInfo.lpBaseOfDll);
+  mModuleSize   = moduleInfo.SizeOfImage;
+#else /* POSIX */
+  Dl_info info;
+  if(!dladdr(containedAddress, &info)) {
+    throw Exception("couldn't retrieve memory information from address");
+  }
+
+  mModuleHandle.reset(dlopen(info.dli_fname, RTLD_NOW), +[](void* handle) {
+    if(handle != nullptr) { dlclose(handle); }
+  });
+
+  if(!mModuleHandle) {
+    throw Exception("couldn't open module handle");
+  }
+
+  mBaseAddress = reinterpret_cast<uintptr_t>(info.dli_fbase);
+  mModuleSize  = this->CalculateModuleSize(info.dli_fbase);
+#endif
+
+  SCANNER_PROBE(construct, mBaseAddress, mModuleSize);
+}
+
+void SignatureScanner::LoadRelocations(RelocationMap* relocations) const {
+  assert(relocations != nullptr);
+
+#ifdef _WIN32
+  const IMAGE_DOS_HEADER* dosHeader =
+    reinterpret_cast<const IMAGE_DOS_HEADER*>(mBaseAddress);
+  const IMAGE_NT_HEADERS* ntHeaders =
+    reinterpret_cast<const IMAGE_NT_HEADERS*>(mBaseAddress + dosHeader->e_lfanew);
+
+  if(dosHeader->e_magic != IMAGE_DOS_SIGNATURE ||
+      ntHeaders->Signature != IMAGE_NT_SIGNATURE) {
+    throw Exception("couldn't find module headers");
+  }
+
+  const IMAGE_DATA_DIRECTORY& directory =
+    ntHeaders->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_BASERELOC];
+
+  uintptr_t block = mBaseAddress + directory.VirtualAddress;
+  const uintptr_t end = block + directory.Size;
+
+  while(directory.VirtualAddress != 0 && block < end) {
+    const IMAGE_BASE_RELOCATION* relocation =
+      reinterpret_cast<const IMAGE_BASE_RELOCATION*>(block);
+    const WORD* entries = reinterpret_cast<const WORD*>(relocation + 1);
+    const size_t count =
+      (relocation->SizeOfBlock - sizeof(IMAGE_BASE_RELOCATION)) / sizeof(WORD);
+
+    if(relocation->SizeOfBlock == 0) {
+      break;
+    }
+
+    for(size_t i = 0; i < count; i++) {
+      const uintptr_t address =
+        mBaseAddress + relocation->VirtualAddress + (entries[i] & 0xFFF);
+
+      switch(entries[i] >> 12) {
+      case IMAGE_REL_BASED_HIGHLOW: relocations->Add(address, 4); break;
+      case IMAGE_REL_BASED_DIR64: relocations->Add(address, 8); break;
+      default: break;
+      }
+    }
+
+    block += relocation->SizeOfBlock;
+  }
+#else /* POSIX */
+  uintptr_t bias = 0;
+  const ElfW(Phdr)* dynamicHeader = FindProgramHeader(mBaseAddress, PT_DYNAMIC, &bias);
+
+  if(dynamicHeader == nullptr) {
+    throw Exception("couldn't find module dynamic section");
+  }
+
+  // The loader relocates most pointers in the dynamic section in place, but
+  // not on every architecture; only unrelocated pointers are adjusted.
+  auto resolve = [&](ElfW(Addr) pointer) -> uintptr_t {
+    if(pointer >= mBaseAddress && pointer < (mBaseAddress + mModuleSize)) {
+      return pointer;
+    }
+
+    return pointer + bias;
+  };
+
+  uintptr_t rela = 0, rel = 0, plt = 0, relr = 0;
+  size_t relaSize = 0, relSize = 0, pltSize = 0, relrSize = 0;
+  size_t relaEntry = sizeof(ElfW(Rela)), relEntry = sizeof(ElfW(Rel));
+  ElfW(Sxword) pltType = DT_RELA;
+
+  for(const ElfW(Dyn)* dynamic = reinterpret_cast<const ElfW(Dyn)*>(
+      bias + dynamicHeader->p_vaddr); dynamic->d_tag != DT_NULL; dynamic++) {
+    switch(dynamic->d_tag) {
+    case DT_RELA: rela = resolve(dynamic->d_un.d_ptr); break;
+    case DT_RELASZ: relaSize = dynamic->d_un.d_val; break;
+    case DT_RELAENT: relaEntry = dynamic->d_un.d_val; break;
+    case DT_REL: rel = resolve(dynamic->d_un.d_ptr); break;
+    case DT_RELSZ: relSize = dynamic->d_un.d_val; break;
+    case DT_RELENT: relEntry = dynamic->d_un.d_val; break;
+    case DT_JMPREL: plt = resolve(dynamic->d_un.d_ptr); break;
+    case DT_PLTRELSZ: pltSize = dynamic->d_un.d_val; break;
+    case DT_PLTREL: pltType = dynamic->d_un.d_val; break;
+#ifdef DT_RELR
+    case DT_RELR: relr = resolve(dynamic->d_un.d_ptr); break;
+    case DT_RELRSZ: relrSize = dynamic->d_un.d_val; break;
+#endif
+    default: break;
+    }
+  }
+
+  // The size of the patched field depends on the relocation type, but in
+  // practice dynamic relocations of position independent code are words.
+  const size_t fieldSize = sizeof(ElfW(Addr));
+
+  for(size_t i = 0; rela && i < (relaSize / relaEntry); i++) {
+    const ElfW(Rela)* entry = reinterpret_cast<const ElfW(Rela)*>(rela + i * relaEntry);
+    relocations->Add(bias + entry->r_offset, fieldSize);
+  }
+
+  for(size_t i = 0; rel && i < (relSize / relEntry); i++) {
+    const ElfW(Rel)* entry = reinterpret_cast<const ElfW(Rel)*>(rel + i * relEntry);
+    relocations->Add(bias + entry->r_offset, fieldSize);
+  }
+
+  const size_t pltEntry = (pltType == DT_RELA) ? sizeof(ElfW(Rela)) : sizeof(ElfW(Rel));
+  for(size_t i = 0; plt && i < (pltSize / pltEntry); i++) {
+    // Both entry types begin with the offset of the field
+    const ElfW(Rel)* entry = reinterpret_cast<const ElfW(Rel)*>(plt + i * pltEntry);
+    relocations->Add(bias + entry->r_offset, fieldSize);
+  }
+
+  // Packed relative relocations consist of addresses (even entries), each
+  // followed by bitmaps (odd entries) of relocated words after the address.
+  uintptr_t where = 0;
+  for(size_t i = 0; relr && i < (relrSize / sizeof(ElfW(Addr))); i++) {
+    const ElfW(Addr) entry = reinterpret_cast<const ElfW(Addr)*>(relr)[i];
+
+    if((entry & 1) == 0) {
+      where = bias + entry;
+      relocations->Add(where, fieldSize);
+      where += fieldSize;
+    } else {
+      const size_t bits = (8 * fieldSize) - 1;
+
+      for(size_t x = 0; x < bits; x++) {
+        if((entry >> (x + 1)) & 1) {
+          relocations->Add(where + x * fieldSize, fieldSize);
+        }
+      }
+
+      where += bits * fieldSize;
+    }
+  }
+#endif
+}
+
+template<typename Callback>
+void SignatureScanner::ForEachRegion(
+    uintptr_t start,
+    uintptr_t end,
+    Callback callback,
+    uint regionFlags /*= 0*/,
+    ScanStatistics::Counters* counters /*= nullptr*/) const {
+  MemoryInformation memoryInfo;
+
+  while(start < end) {
+    if(counters != nullptr) {
+      const auto lookup = std::chrono::steady_clock::now();
+      this->GetMemoryInfo(reinterpret_cast<void*>(start), &memoryInfo);
+      counters->regionLookupNanoseconds += GetElapsedNanoseconds(lookup);
+    } else {
+      this->GetMemoryInfo(reinterpret_cast<void*>(start), &memoryInfo);
+    }
+
+    // Calculate the bounds for the current memory region
+    uintptr_t region = reinterpret_cast<uintptr_t>(memoryInfo.baseAddress) +
+      memoryInfo.regionSize;
+
+    const bool eligible = this->IsMemoryEligible(memoryInfo, regionFlags);
+    SCANNER_PROBE(region, start, region, static_cast<int>(eligible));
+
+    if(counters != nullptr) {
+      (eligible ? counters->regionsVisited : counters->regionsSkipped)++;
+    }
+
+    if(eligible) {
+      bool proceed = callback(
+        reinterpret_cast<const byte*>(start),
+        reinterpret_cast<const byte*>(std::min(region, end)));
+
+      if(!proceed) {
+        break;
+      }
+    }
+
+    start = region;
+  }
+}
+
+template<typename Callback, typename Filter>
+void SignatureScanner::ForEachMatch(
+    const std::vector<Signature>& signatures,
+    const std::vector<Resolver>& resolvers,
+    size_t offset,
+    size_t length,
+    uint flags,
+    Callback callback,
+    Filter filter,
+    uint regionFlags /*= 0*/,
+    const CancellationToken* token /*= nullptr*/) const {
+  uintptr_t start = mBaseAddress + offset;
+  uintptr_t end = mBaseAddress + std::min(mModuleSize, length);
+
+  assert(start < end);
+  Tracer::Scope scope("search", signatures.size());
+
+  std::shared_ptr<const ByteProfile> profile = this->GetCachedByteProfile();
+  bool resolve = false;
+
+  for(size_t i = 0; i < signatures.size(); i++) {
+    resolve |= !resolvers[i].IsEmpty();
+  }
+
+  const RelocationMap* relocations = (flags & IgnoreRelocations) ?
+    &this->GetRelocationMap() : nullptr;
+  const FunctionIndex* functions = (flags & FunctionStarts) ?
+    &this->GetFunctionIndex() : nullptr;
+  std::shared_ptr<const RegionList> readable = resolve ?
+    this->GetAccessibleRegions() : nullptr;
+
+  // Counting is only performed when statistics are attached
+  std::shared_ptr<ScanStatistics> statistics = mStatistics;
+  ScanStatistics::Counters counts;
+  ScanStatistics::Counters* counters = statistics ? &counts : nullptr;
+
+  // Each signature is charged its own work, since a batch shares the walk
+  std::vector<uint64_t> latencies(statistics ? signatures.size() : 0, 0);
+  auto now = [&]() {
+    return statistics ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point();
+  };
+  auto charge = [&](size_t i, std::chrono::steady_clock::time_point since) {
+    if(statistics) {
+      latencies[i] += GetElapsedNanoseconds(since);
+    }
+  };
+
+  // Large batches are prefiltered in a single pass. Relocated bytes are
+  // invisible to the prefilter, so ignoring them requires regular searches.
+  // Every prefilter covers a limited number of signatures, with a pass each.
+  std::vector<std::unique_ptr<Teddy>> prefilters;
+  std::vector<bool> prefiltered(signatures.size(), false);
+  std::vector<Teddy::Candidate> candidates;
+
+  if(relocations == nullptr && functions == nullptr &&
+      signatures.size() >= TeddyMinimumSignatures && Teddy::IsSupported()) {
+    std::vector<size_t> remaining;
+    for(size_t i = 0; i < signatures.size(); i++) {
+      remaining.push_back(i);
+    }
+
+    // Aligned signatures are searched at eligible positions only
+    remaining.erase(std::remove_if(remaining.begin(), remaining.end(), [&](size_t i) {
+      return signatures[i].GetAlignment() > 1;
+    }), remaining.end());
+
+    while(remaining.size() >= TeddyMinimumSignatures) {
+      std::unique_ptr<Teddy> teddy(new Teddy(
+        signatures,
+        remaining,
+        profile ? *profile : ByteProfile::GetStaticProfile()));
+
+      const size_t considered = std::min(remaining.size(), Teddy::MaxSignatures);
+      remaining.erase(remaining.begin(), remaining.begin() + considered);
+
+      if(teddy->GetCount() < TeddyMinimumSignatures) {
+        continue;
+      }
+
+      for(size_t i = 0; i < signatures.size(); i++) {
+        prefiltered[i] = prefiltered[i] || teddy->Contains(i);
+      }
+
+      prefilters.push_back(std::move(teddy));
+    }
+  }
+
+  // The remaining signatures are searched one at a time, by the engine a
+  // single search would select (function starts are compared directly)
+  std::vector<std::unique_ptr<const SignatureEngine>> engines(signatures.size());
+
+  for(size_t i = 0; i < signatures.size() && functions == nullptr; i++) {
+    if(!prefiltered[i]) {
+      engines[i].reset(new SignatureEngine(signatures[i], profile.get(), relocations));
+    }
+  }
+
+  // Reports a match, returning false if the iteration should stop
+  auto report = [&](size_t i, const byte* position) {
+    if(counters != nullptr) {
+      counters->matches++;
+    }
+
+    SCANNER_PROBE(match, mBaseAddress, GetSignatureId(signatures[i]), position);
+
+    uintptr_t result = reinterpret_cast<uintptr_t>(position);
+    if(!resolvers[i].IsEmpty() &&
+        !ResolveMatch(resolvers[i], *readable, result, &result)) {
+      return true;
+    }
+
+    return callback(i, result);
+  };
+
+  // Matches never span several memory regions. All signatures are searched
+  // for within a region, one chunk at a time, before proceeding to the next
+  // one. A match may extend past the end of its chunk.
+  this->ForEachRegion(start, end, [&](const byte* begin, const byte* limit) {
+    SCANNER_PROBE(scan_start, mBaseAddress, begin, limit, signatures.size());
+    Tracer::Scope regionScope("region", limit - begin);
+
+    // Only the function starts within the region are compared
+    if(functions != nullptr) {
+      if(token != nullptr && token->IsCancelled()) {
+        throw CancelledException();
+      }
+
+      Tracer::Scope verificationScope("verification");
+
+      for(auto function = functions->LowerBound(reinterpret_cast<uintptr_t>(begin));
+          function != functions->GetFunctions().end() &&
+          function->address < reinterpret_cast<uintptr_t>(limit);
+          ++function) {
+        const byte* position = reinterpret_cast<const byte*>(function->address);
+
+        for(size_t i = 0; i < signatures.size(); i++) {
+          if(static_cast<size_t>(limit - position) < signatures[i].GetSize() ||
+              !signatures[i].IsAligned(position) ||
+              !filter(i)) {
+            continue;
+          }
+
+          if(counters != nullptr) {
+            counters->candidates++;
+            counters->verifications++;
+          }
+
+          const auto verifying = now();
+          const bool matches = relocations ?
+            AnchorSearch::MatchesRelocated(position, signatures[i], *relocations) :
+            signatures[i].Matches(position);
+          const bool proceed = !matches || report(i, position);
+          charge(i, verifying);
+
+          if(!proceed) {
+            SCANNER_PROBE(scan_end, mBaseAddress, begin, limit, signatures.size());
+            return false;
+          }
+        }
+      }
+
+      SCANNER_PROBE(scan_end, mBaseAddress, begin, limit, signatures.size());
+      return true;
+    }
+
+    for(const byte* chunk = begin; chunk < limit; chunk += ChunkSize) {
+      if(token != nullptr && token->IsCancelled()) {
+        throw CancelledException();
+      }
+
+      const size_t available = limit - chunk;
+      const byte* chunkEnd = chunk + std::min(available, ChunkSize);
+      Tracer::Scope chunkScope("chunk", chunkEnd - chunk);
+
+      if(counters != nullptr) {
+        counters->bytesScanned += chunkEnd - chunk;
+      }
+
+      for(const std::unique_ptr<Teddy>& teddy : prefilters) {
+        // The fragments of matches that start within the chunk may be
+        // located past its end.
+        candidates.clear();
+        const auto filtering = now();
+        teddy->Find(chunk, chunk + std::min(available,
+          ChunkSize + teddy->GetMaxOffset() + Teddy::MaxFragmentLength), &candidates);
+
+        // The pass is shared evenly by the signatures it covers
+        if(statistics) {
+          const uint64_t share = GetElapsedNanoseconds(filtering) / teddy->GetCount();
+
+          for(size_t i = 0; i < signatures.size(); i++) {
+            latencies[i] += teddy->Contains(i) ? share : 0;
+          }
+        }
+
+        Tracer::Scope verificationScope("verification", candidates.size());
+
+        for(const Teddy::Candidate& candidate : candidates) {
+          for(uint32_t buckets = candidate.second; buckets != 0; buckets &= buckets - 1) {
+            for(size_t i : teddy->GetBucket(Bits::CountTrailingZeros(buckets))) {
+              const size_t fragmentOffset = teddy->GetOffset(i);
+
+              if(static_cast<size_t>(candidate.first - chunk) < fragmentOffset) {
+                continue;
+              }
+
+              const byte* position = candidate.first - fragmentOffset;
+              if(position >= chunkEnd ||
+                  static_cast<size_t>(limit - position) < signatures[i].GetSize() ||
+                  !teddy->MatchesFragment(i, candidate.first) ||
+                  !filter(i)) {
+                continue;
+              }
+
+              if(counters != nullptr) {
+                counters->candidates++;
+                counters->verifications++;
+              }
+
+              const auto verifying = now();
+              const bool proceed = !signatures[i].Matches(position) || report(i, position);
+              charge(i, verifying);
+
+              if(!proceed) {
+                SCANNER_PROBE(scan_end, mBaseAddress, begin, limit, signatures.size());
+                return false;
+              }
+            }
+          }
+        }
+      }
+
+      for(size_t i = 0; i < signatures.size(); i++) {
+        if(prefiltered[i]) {
+          continue;
+        }
+
+        const byte* chunkLimit = chunk + std::min(
+          available, ChunkSize + signatures[i].GetSize() - 1);
+        const auto searching = now();
+
+        for(const byte* position = chunk; filter(i); position++) {
+          position = engines[i]->Find(position, chunkLimit, counters);
+
+          if(position == nullptr) {
+            break;
+          }
+
+          if(!report(i, position)) {
+            charge(i, searching);
+            SCANNER_PROBE(scan_end, mBaseAddress, begin, limit, signatures.size());
+            return false;
+          }
+        }
+
+        charge(i, searching);
+      }
+
+      if(available <= ChunkSize) {
+        break;
+      }
+    }
+
+    SCANNER_PROBE(scan_end, mBaseAddress, begin, limit, signatures.size());
+    return true;
+  }, regionFlags, counters);
+
+  if(statistics) {
+    for(size_t i = 0; i < signatures.size(); i++) {
+      statistics->RecordLatency(signatures[i].ToString(), latencies[i]);
+    }
+
+    statistics->Record(counts);
+    ScanStatistics::SetLastScan(counts);
+  }
+}
+
+template<typename Search>
+uintptr_t SignatureScanner::FindCachedMatch(
+    const Signature& signature,
+    const Resolver* resolver,
+    size_t offset,
+    size_t length,
+    uint flags,
+    Search search) const {
+  std::shared_ptr<ResultCache> cache = mResultCache;
+  if(!cache) {
+    return search();
+  }
+
+  // Dereferenced values (e.g global pointers) change at runtime
+  for(size_t i = 0; resolver != nullptr && i < resolver->GetSteps().size(); i++) {
+    if(resolver->GetSteps()[i].type == Resolver::Step::Dereference) {
+      return search();
+    }
+  }
+
+  std::shared_ptr<const std::string> buildId;
+  {
+    std::lock_guard<std::mutex> lock(mCache->mutex);
+    buildId = mCache->buildId;
+  }
+
+  if(!buildId) {
+    auto identifier = std::make_shared<const std::string>(this->GetBuildId());
+
+    std::lock_guard<std::mutex> lock(mCache->mutex);
+    if(!mCache->buildId) {
+      mCache->buildId = identifier;
+    }
+
+    buildId = mCache->buildId;
+  }
+
+  // The results of unidentifiable builds may differ between processes
+  if(buildId->empty()) {
+    return search();
+  }
+
+  uint64_t key = Fnv::HashBytes(Fnv::Basis, buildId->data(), buildId->size());
+  key = Fnv::HashValue(key, signature.GetSize());
+  key = Fnv::HashValue(key, GetSignatureId(signature));
+  key = Fnv::HashValue(key, signature.GetAlignment());
+  key = Fnv::HashValue(key, signature.GetAlignmentRemainder());
+  key = Fnv::HashValue(key, offset);
+  key = Fnv::HashValue(key, length);
+  key = Fnv::HashValue(key, flags);
+
+  for(size_t i = 0; resolver != nullptr && i < resolver->GetSteps().size(); i++) {
+    const Resolver::Step& step = resolver->GetSteps()[i];
+
+    key = Fnv::HashValue(key, step.type);
+    key = Fnv::HashValue(key, static_cast<uint64_t>(step.value));
+    key = Fnv::HashValue(key, step.length);
+  }
+
+  // Zero denotes a free slot
+  key = std::max<uint64_t>(key, 1);
+
+  size_t cached;
+  if(cache->Find(key, &cached) && (cached == ResultCache::npos || cached < mModuleSize)) {
+    return cached == ResultCache::npos ? 0 : mBaseAddress + cached;
+  }
+
+  const uintptr_t result = search();
+
+  // A resolved search may fail because of its matches' resolution rather
+  // than for lack of matches, so only plain misses are cached
+  if(result == 0 && resolver == nullptr) {
+    cache->Insert(key, ResultCache::npos);
+  } else if((result - mBaseAddress) < mModuleSize) {
+    cache->Insert(key, result - mBaseAddress);
+  }
+
+  return result;
+}
+
+uintptr_t SignatureScanner::FindSignature(
+    const std::vector<byte>& signature,
+    const char* mask,
+    size_t offset /*= 0*/,
+    size_t length /*= npos*/,
+    uint flags /*= 0*/) const {
+  assert(mask != nullptr);
+  assert(signature.size() == strlen(mask));
+
+  return this->FindSignature(Signature(signature, mask), offset, length, flags);
+}
+
+uintptr_t SignatureScanner::FindSignature(
+    const Signature& signature,
+    size_t offset /*= 0*/,
+    size_t length /*= npos*/,
+    uint flags /*= 0*/) const {
+  return this->FindCachedMatch(signature, nullptr, offset, length, flags, [&]() {
+    return this->FindFirstMatch(signature, offset, length, flags);
+  });
+}
+
+uintptr_t SignatureScanner::FindSignature(
+    const byte* values,
+    const char* mask,
+    size_t size,
+    size_t offset /*= 0*/,
+    size_t length /*= npos*/,
+    uint flags /*= 0*/) const {
+  return this->FindSignature(Signature(values, mask, size), offset, length, flags);
+}
+
+uintptr_t SignatureScanner::FindSignature(
+    const byte* values,
+    const byte* masks,
+    size_t size,
+    size_t offset /*= 0*/,
+    size_t length /*= npos*/,
+    uint flags /*= 0*/) const {
+  return this->FindSignature(Signature(values, masks, size), offset, length, flags);
+}
+
+uintptr_t SignatureScanner::FindSignature(
+    const byte* values,
+    const uint64_t* bitmap,
+    size_t size,
+    size_t offset /*= 0*/,
+    size_t length /*= npos*/,
+    uint flags /*= 0*/) const {
+  return this->FindSignature(Signature(values, bitmap, size), offset, length, flags);
+}
+
+uintptr_t SignatureScanner::FindSignature(
+    const Signature& signature,
+    const Resolver& resolver,
+    size_t offset /*= 0*/,
+    size_t length /*= npos*/,
+    uint flags /*= 0*/) const {
+  return this->FindCachedMatch(signature, &resolver, offset, length, flags, [&]() {
+    std::vector<uintptr_t> results = this->FindSignatures(
+      std::vector<Signature>(1, signature),
+      std::vector<Resolver>(1, resolver),
+      offset,
+      length,
+      flags);
+
+    return results[0];
+  });
+}
+
+std::vector<uintptr_t> SignatureScanner::FindSignatures(
+    const std::vector<Signature>& signatures,
+    size_t offset /*= 0*/,
+    size_t length /*= npos*/,
+    uint flags /*= 0*/) const {
+  return this->FindSignatures(
+    signatures,
+    std::vector<Resolver>(signatures.size()),
+    offset,
+    length,
+    flags);
+}
+
+std::vector<uintptr_t> SignatureScanner::FindSignatures(
+    const std::vector<Signature>& signatures,
+    const std::vector<Resolver>& resolvers,
+    size_t offset /*= 0*/,
+    size_t length /*= npos*/,
+    uint flags /*= 0*/) const {
+  return this->FindFirstMatches(signatures, resolvers, offset, length, flags, nullptr);
+}
+
+uintptr_t SignatureScanner::FindFirstMatch(
+    const Signature& signature,
+    size_t offset,
+    size_t length,
+    uint flags) const {
+  // Instrumented and function start searches take the general path (which,
+  // unlike <FindSignature>, does not consult the result cache again)
+  if(mStatistics || (flags & FunctionStarts) || signature.GetSize() == 0) {
+    return this->FindSignatures(std::vector<Signature>(1, signature), offset, length, flags)[0];
+  }
+
+  uintptr_t start = mBaseAddress + offset;
+  uintptr_t end = mBaseAddress + std::min(mModuleSize, length);
+
+  assert(start < end);
+  Tracer::Scope scope("search", 1);
+
+  std::shared_ptr<const ByteProfile> profile = this->GetCachedByteProfile();
+  const RelocationMap* relocations = (flags & IgnoreRelocations) ?
+    &this->GetRelocationMap() : nullptr;
+  std::shared_ptr<const RegionList> regions = this->GetSearchableRegions();
+
+  // The engine is selected as in <ForEachMatch>, but held in place
+  const SignatureEngine engine(signature, profile.get(), relocations);
+
+  return FindFirstInRegions(*regions, start, end, mBaseAddress, signature,
+      [&](const byte* begin, const byte* limit) {
+    return engine.Find(begin, limit);
+  });
+}
+
+std::vector<uintptr_t> SignatureScanner::FindFirstMatches(
+    const std::vector<Signature>& signatures,
+    const std::vector<Resolver>& resolvers,
+    size_t offset,
+    size_t length,
+    uint flags,
+    const CancellationToken* token) const {
+  assert(signatures.size() == resolvers.size());
+
+  std::vector<uintptr_t> results(signatures.size(), 0);
+  std::vector<bool> found(signatures.size(), false);
+  size_t remaining = signatures.size();
+
+  this->ForEachMatch(signatures, resolvers, offset, length, flags,
+      [&](size_t index, uintptr_t result) {
+    if(found[index]) {
+      return true;
+    }
+
+    results[index] = result;
+    found[index] = true;
+
+    // Other signatures may still have matches in the same region
+    return --remaining > 0;
+  }, [&](size_t index) {
+    return !found[index];
+  }, 0, token);
+
+  return results;
+}
+
+std::vector<uintptr_t> SignatureScanner::FindAllSignatures(
+    const Signature& signature,
+    size_t offset /*= 0*/,
+    size_t length /*= npos*/,
+    uint flags /*= 0*/) const {
+  return this->FindAllSignatures(signature, Resolver(), offset, length, flags);
+}
+
+std::vector<uintptr_t> SignatureScanner::FindAllSignatures(
+    const Signature& signature,
+    const Resolver& resolver,
+    size_t offset /*= 0*/,
+    size_t length /*= npos*/,
+    uint flags /*= 0*/) const {
+  return this->FindEveryMatch(signature, resolver, offset, length, flags, nullptr);
+}
+
+uintptr_t SignatureScanner::FindSignatureInFunction(
+    const Signature& signature,
+    uintptr_t address,
+    uint flags /*= 0*/) const {
+  const FunctionIndex::Function* function = this->GetFunctionIndex().Find(address);
+
+  if(function == nullptr || function->size == 0) {
+    return 0;
+  }
+
+  const size_t offset = function->address - mBaseAddress;
+  return this->FindSignature(signature, offset, offset + function->size, flags);
+}
+
+std::vector<uintptr_t> SignatureScanner::FindEveryMatch(
+    const Signature& signature,
+    const Resolver& resolver,
+    size_t offset,
+    size_t length,
+    uint flags,
+    const CancellationToken* token) const {
+  std::vector<uintptr_t> results;
+
+  this->ForEachMatch(
+      std::vector<Signature>(1, signature),
+      std::vector<Resolver>(1, resolver),
+      offset,
+      length,
+      flags,
+      [&](size_t, uintptr_t result) {
+    results.push_back(result);
+    return true;
+  }, [](size_t) {
+    return true;
+  }, 0, token);
+
+  return results;
+}
+
+template<typename Result, typename Search>
+std::future<Result> SignatureScanner::RunAsync(
+    const Executor& executor,
+    Search search) const {
+  std::shared_ptr<std::promise<Result>> promise = std::make_shared<std::promise<Result>>();
+  std::future<Result> future = promise->get_future();
+
+  std::function<void()> task = [promise, search]() {
+    try {
+      promise->set_value(search());
+    } catch(...) {
+      promise->set_exception(std::current_exception());
+    }
+  };
+
+  if(executor) {
+    executor(task);
+  } else {
+    std::thread(task).detach();
+  }
+
+  return future;
+}
+
+std::future<uintptr_t> SignatureScanner::FindSignatureAsync(
+    const Signature& signature,
+    const CancellationToken& token /*= CancellationToken()*/,
+    const Executor& executor /*= Executor()*/,
+    size_t offset /*= 0*/,
+    size_t length /*= npos*/,
+    uint flags /*= 0*/) const {
+  // The search owns a copy of the scanner, which keeps the module loaded
+  const SignatureScanner scanner(*this);
+
+  return this->RunAsync<uintptr_t>(executor, [=]() {
+    return scanner.FindFirstMatches(
+      std::vector<Signature>(1, signature),
+      std::vector<Resolver>(1),
+      offset,
+      length,
+      flags,
+      &token)[0];
+  });
+}
+
+std::future<std::vector<uintptr_t>> SignatureScanner::FindSignaturesAsync(
+    const std::vector<Signature>& signatures,
+    const CancellationToken& token /*= CancellationToken()*/,
+    const Executor& executor /*= Executor()*/,
+    size_t offset /*= 0*/,
+    size_t length /*= npos*/,
+    uint flags /*= 0*/) const {
+  const SignatureScanner scanner(*this);
+
+  return this->RunAsync<std::vector<uintptr_t>>(executor, [=]() {
+    return scanner.FindFirstMatches(
+      signatures,
+      std::vector<Resolver>(signatures.size()),
+      offset,
+      length,
+      flags,
+      &token);
+  });
+}
+
+std::future<std::vector<uintptr_t>> SignatureScanner::FindAllSignaturesAsync(
+    const Signature& signature,
+    const CancellationToken& token /*= CancellationToken()*/,
+    const Executor& executor /*= Executor()*/,
+    size_t offset /*= 0*/,
+    size_t length /*= npos*/,
+    uint flags /*= 0*/) const {
+  const SignatureScanner scanner(*this);
+
+  return this->RunAsync<std::vector<uintptr_t>>(executor, [=]() {
+    return scanner.FindEveryMatch(signature, Resolver(), offset, length, flags, &token);
+  });
+}
+
+std::vector<SelectivityReport> SignatureScanner::ProfileSignatures(
+    const std::vector<Signature>& signatures,
+    size_t offset /*= 0*/,
+    size_t length /*= npos*/,
+    uint flags /*= 0*/) const {
+  uintptr_t start = mBaseAddress + offset;
+  uintptr_t end = mBaseAddress + std::min(mModuleSize, length);
+
+  assert(start < end);
+
+  // The anchors are selected before the module profile is computed
+  std::shared_ptr<const ByteProfile> profile = this->GetCachedByteProfile();
+
+  const RelocationMap* relocations = (flags & IgnoreRelocations) ?
+    &this->GetRelocationMap() : nullptr;
+  const ByteProfile& moduleProfile = this->GetByteProfile();
+
+  // Bytes patched by the loader differ between loads, even if they are
+  // equal in every match, so they are never suggested as tightenings.
+  // Modules without relocation tables have no such bytes.
+  const RelocationMap* relocated = relocations;
+
+  if(relocated == nullptr) {
+    try {
+      relocated = &this->GetRelocationMap();
+    } catch(const Exception&) {
+    }
+  }
+
+  // Checks if a byte varies between loads or builds, i.e it is relocated or
+  // part of a relative operand that refers to the module (see
+  // <LoadFingerprints>).
+  auto isVolatile = [&](const byte* begin, const byte* limit, const byte* position) {
+    if(relocated && relocated->IsRelocated(reinterpret_cast<uintptr_t>(position))) {
+      return true;
+    }
+
+    for(size_t x = 0; x < sizeof(int32_t); x++) {
+      const byte* operand = position - x;
+
+      if(operand < begin || static_cast<size_t>(limit - operand) < sizeof(int32_t)) {
+        continue;
+      }
+
+      const uintptr_t destination = ReferenceSearch::GetDestination(operand);
+
+      if(destination >= mBaseAddress &&
+          destination < (mBaseAddress + mModuleSize) &&
+          ReferenceSearch::GetInstruction(begin, operand) != nullptr) {
+        return true;
+      }
+    }
+
+    return false;
+  };
+
+  std::vector<SelectivityReport> reports(signatures.size());
+  uint64_t total = 0;
+
+  for(size_t i = 0; i < signatures.size(); i++) {
+    const Signature& signature = signatures[i];
+    const size_t size = signature.GetSize();
+    const byte* values = signature.GetValues();
+    const byte* masks = signature.GetMasks();
+    SelectivityReport& report = reports[i];
+
+    const AnchorSearch::Anchor anchor = AnchorSearch::SelectAnchor(
+      signature,
+      profile ? *profile : ByteProfile::GetStaticProfile());
+
+    report.signature = signature.ToString();
+    report.anchorIndex = anchor.index;
+    report.anchorLength = anchor.length;
+    report.failures.assign(size, 0);
+
+    // The bytes of every match, at positions that are not entirely compared
+    std::vector<int> observed(size, -1);
+    std::vector<bool> constant(size, true);
+
+    // Verifies a candidate within a region, recording the first mismatching
+    // byte
+    auto verify = [&](const byte* begin, const byte* limit, const byte* candidate) {
+      if(!signature.IsAligned(candidate)) {
+        return;
+      }
+
+      report.anchorHits++;
+
+      for(size_t x = 0; x < size; x++) {
+        if((candidate[x] & masks[x]) != values[x] &&
+            !(relocations && relocations->IsRelocated(reinterpret_cast<uintptr_t>(candidate + x)))) {
+          report.failures[x]++;
+          return;
+        }
+      }
+
+      report.matches++;
+
+      for(size_t x = 0; x < size; x++) {
+        if(masks[x] != 0xFF && constant[x]) {
+          constant[x] = (observed[x] < 0 || observed[x] == candidate[x]) &&
+            !isVolatile(begin, limit, candidate + x);
+          observed[x] = candidate[x];
+        }
+      }
+    };
+
+    const auto started = std::chrono::steady_clock::now();
+
+    // Candidates whose anchor overlaps a relocated byte are not enumerated
+    this->ForEachRegion(start, end, [&](const byte* begin, const byte* limit) {
+      if(static_cast<size_t>(limit - begin) < size) {
+        return true;
+      }
+
+      if(anchor.length == 0) {
+        for(const byte* candidate = begin; candidate <= (limit - size); candidate++) {
+          verify(begin, limit, candidate);
+        }
+
+        return true;
+      }
+
+      const byte* anchorLimit = limit - size + anchor.index + anchor.length;
+
+      for(const byte* position = begin + anchor.index;; position++) {
+        position = AnchorSearch::FindAnchor(
+          position, anchorLimit, values + anchor.index, anchor.length);
+
+        if(position == nullptr) {
+          break;
+        }
+
+        verify(begin, limit, position - anchor.index);
+      }
+
+      return true;
+    });
+
+    report.nanoseconds = GetElapsedNanoseconds(started);
+    total += report.nanoseconds;
+
+    const AnchorSearch::Anchor suggested = AnchorSearch::SelectAnchor(signature, moduleProfile);
+    if(suggested.length > 0) {
+      const byte* anchorValues = values + suggested.index;
+      const double frequency = (suggested.length == 1) ?
+        moduleProfile.GetByteFrequency(anchorValues[0]) :
+        moduleProfile.GetPairFrequency(anchorValues[0], anchorValues[1]);
+
+      report.suggestedAnchorIndex = suggested.index;
+      report.suggestedAnchorLength = suggested.length;
+      report.suggestedAnchorHits = static_cast<uint64_t>(
+        frequency * moduleProfile.GetByteCount() + 0.5);
+    }
+
+    // A single match says nothing about which bytes are constant
+    for(size_t x = 0; x < size; x++) {
+      if(report.matches >= 2 && masks[x] != 0xFF && constant[x]) {
+        report.tightenings.push_back(std::make_pair(x, static_cast<byte>(observed[x])));
+      }
+    }
+  }
+
+  for(SelectivityReport& report : reports) {
+    report.timeShare = (total > 0) ? static_cast<double>(report.nanoseconds) / total : 0.0;
+  }
+
+  return reports;
+}
+
+#ifdef SCANNER_COROUTINES
+Generator<uintptr_t> SignatureScanner::Matches(
+    Signature signature,
+    size_t offset /*= 0*/,
+    size_t length /*= npos*/,
+    uint flags /*= 0*/) const {
+  uintptr_t start = mBaseAddress + offset;
+  uintptr_t end = mBaseAddress + std::min(mModuleSize, length);
+
+  assert(start < end);
+
+  std::shared_ptr<const ByteProfile> profile = this->GetCachedByteProfile();
+  const RelocationMap* relocations = (flags & IgnoreRelocations) ?
+    &this->GetRelocationMap() : nullptr;
+  const SignatureEngine engine(signature, profile.get(), relocations);
+
+  // The regions are enumerated up front, the search of each one is lazy
+  RegionList regions;
+  this->ForEachRegion(start, end, [&](const byte* begin, const byte* limit) {
+    regions.push_back(std::make_pair(
+      reinterpret_cast<uintptr_t>(begin),
+      reinterpret_cast<uintptr_t>(limit)));
+    return true;
+  });
+
+  for(const std::pair<uintptr_t, uintptr_t>& region : regions) {
+    const byte* limit = reinterpret_cast<const byte*>(region.second);
+
+    for(const byte* position = reinterpret_cast<const byte*>(region.first);; position++) {
+      position = engine.Find(position, limit);
+
+      if(position == nullptr) {
+        break;
+      }
+
+      co_yield reinterpret_cast<uintptr_t>(position);
+    }
+  }
+}
+#endif
+
+uintptr_t SignatureScanner::FindPattern(
+    const Pattern& pattern,
+    size_t offset /*= 0*/,
+    size_t length /*= npos*/) const {
+  uintptr_t start = mBaseAddress + offset;
+  uintptr_t end = mBaseAddress + std::min(mModuleSize, length);
+
+  assert(start < end);
+
+  const byte* result = nullptr;
+
+  this->ForEachRegion(start, end, [&](const byte* begin, const byte* limit) {
+    result = pattern.Find(begin, limit);
+    return result == nullptr;
+  });
+
+  return reinterpret_cast<uintptr_t>(result);
+}
+
+std::vector<uintptr_t> SignatureScanner::FindReferences(
+    uintptr_t target,
+    size_t offset /*= 0*/,
+    size_t length /*= npos*/,
+    uint referenceFlags /*= RelativeReferences*/) const {
+  return this->FindReferences(
+    std::vector<uintptr_t>(1, target),
+    offset,
+    length,
+    referenceFlags)[0];
+}
+
+std::vector<std::vector<uintptr_t>> SignatureScanner::FindReferences(
+    const std::vector<uintptr_t>& targets,
+    size_t offset /*= 0*/,
+    size_t length /*= npos*/,
+    uint referenceFlags /*= RelativeReferences*/) const {
+  uintptr_t start = mBaseAddress + offset;
+  uintptr_t end = mBaseAddress + std::min(mModuleSize, length);
+
+  assert(start < end);
+
+  std::vector<std::vector<uintptr_t>> results(targets.size());
+  if(targets.empty()) {
+    return results;
+  }
+
+  // The targets are sorted (retaining their index) for binary searching
+  std::vector<std::pair<uintptr_t, size_t>> sorted;
+  for(size_t i = 0; i < targets.size(); i++) {
+    sorted.push_back(std::make_pair(targets[i], i));
+  }
+
+  std::sort(sorted.begin(), sorted.end());
+
+  std::vector<const byte*> operands;
+  std::vector<std::pair<uintptr_t, size_t>> references;
+
+  // Adds a reference to every target equal to the destination
+  auto addReference = [&](uintptr_t destination, const byte* instruction) {
+    auto match = std::lower_bound(
+      sorted.begin(),
+      sorted.end(),
+      std::make_pair(destination, size_t(0)));
+
+    for(; match != sorted.end() && match->first == destination; ++match) {
+      references.push_back(std::make_pair(
+        reinterpret_cast<uintptr_t>(instruction), match->second));
+    }
+  };
+
+  this->ForEachRegion(start, end, [&](const byte* begin, const byte* limit) {
+    references.clear();
+
+    if(referenceFlags & RelativeReferences) {
+      operands.clear();
+      ReferenceSearch::FindOperands(
+        begin,
+        limit,
+        sorted.front().first,
+        sorted.back().first,
+        &operands);
+
+      for(const byte* operand : operands) {
+        const byte* instruction = ReferenceSearch::GetInstruction(begin, operand);
+
+        if(instruction != nullptr) {
+          addReference(ReferenceSearch::GetDestination(operand), instruction);
+        }
+      }
+    }
+
+    if(referenceFlags & AbsoluteReferences) {
+      operands.clear();
+      ReferenceSearch::FindValues(
+        begin,
+        limit,
+        sorted.front().first,
+        sorted.back().first,
+        &operands);
+
+      for(const byte* value : operands) {
+        addReference(
+          ReferenceSearch::GetValue(value),
+          ReferenceSearch::GetAbsoluteInstruction(begin, value));
+      }
+    }
+
+    // Both kinds of references are reported in ascending order
+    std::sort(references.begin(), references.end());
+
+    for(const std::pair<uintptr_t, size_t>& reference : references) {
+      results[reference.second].push_back(reference.first);
+    }
+
+    return true;
+  }, ExecutableRegion);
+
+  return results;
 }
-#include <unistd.h>
-SignatureScanner::SignatureScanner(void* containedAddress) :
-    mBaseAddress(0),
-    mModuleSize(0)
-{
-  assert(containedAddress != nullptr);
 
+std::vector<uintptr_t> SignatureScanner::FindPointers(
+    uintptr_t lower,
+    uintptr_t upper,
+    size_t offset /*= 0*/,
+    size_t length /*= npos*/,
+    uint regionFlags /*= 0*/) const {
+  uintptr_t start = mBaseAddress + offset;
+  uintptr_t end = mBaseAddress + std::min(mModuleSize, length);
+
+  assert(start < end);
+  return this->FindPointers(lower, upper, RegionList(1, std::make_pair(start, end)), regionFlags);
+}
+
+std::vector<uintptr_t> SignatureScanner::FindPointers(
+    uintptr_t lower,
+    uintptr_t upper,
+    const RegionList& ranges,
+    uint regionFlags /*= 0*/) const {
+  std::vector<uintptr_t> results;
+  if(lower >= upper) {
+    return results;
+  }
+
+  std::vector<const byte*> pointers;
+  for(const std::pair<uintptr_t, uintptr_t>& range : ranges) {
+    assert(range.first <= range.second);
+
+    this->ForEachRegion(range.first, range.second, [&](const byte* begin, const byte* limit) {
+      pointers.clear();
+      ReferenceSearch::FindPointers(begin, limit, lower, upper - 1, &pointers);
+
+      for(const byte* pointer : pointers) {
+        results.push_back(reinterpret_cast<uintptr_t>(pointer));
+      }
+
+      return true;
+    }, regionFlags);
+  }
+
+  return results;
+}
+
+uintptr_t SignatureScanner::FindString(
+    const std::string& text,
+    StringEncoding encoding /*= AsciiString*/) const {
+  uintptr_t result = 0;
+
+  this->ForEachMatch(
+      std::vector<Signature>(1, CreateStringSignature(text, encoding)),
+      std::vector<Resolver>(1),
+      0,
+      npos,
+      0,
+      [&](size_t, uintptr_t match) {
+    result = match;
+    return false;
+  }, [](size_t) {
+    return true;
+  }, ReadOnlyRegion);
+
+  return result;
+}
+
+std::vector<uintptr_t> SignatureScanner::FindStringReferences(
+    const std::string& text,
+    StringEncoding encoding /*= AsciiString*/) const {
+  std::vector<uintptr_t> strings;
+
+  this->ForEachMatch(
+      std::vector<Signature>(1, CreateStringSignature(text, encoding)),
+      std::vector<Resolver>(1),
+      0,
+      npos,
+      0,
+      [&](size_t, uintptr_t match) {
+    strings.push_back(match);
+    return true;
+  }, [](size_t) {
+    return true;
+  }, ReadOnlyRegion);
+
+  if(strings.empty()) {
+    return std::vector<uintptr_t>();
+  }
+
+  std::vector<std::vector<uintptr_t>> references = this->FindReferences(
+    strings,
+    0,
+    npos,
+    RelativeReferences | AbsoluteReferences);
+
+  // Merge the references of every occurrence into a single sorted list
+  std::vector<uintptr_t> results;
+  for(const std::vector<uintptr_t>& occurrence : references) {
+    results.insert(results.end(), occurrence.begin(), occurrence.end());
+  }
+
+  std::sort(results.begin(), results.end());
+  results.erase(std::unique(results.begin(), results.end()), results.end());
+  return results;
+}
+
+void* SignatureScanner::FindSymbol(const std::string& symbol) const {
 #ifdef _WIN32
-  HMODULE module;
-  if(!GetModuleHandleEx(
-      GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS,
-      containedAddress)) {
-    throw Exception("couldn't retrieve memory module handle");
+  return GetProcAddress(mModuleHandle.get(), symbol.c_str());
+#else /* POSIX */
+  return dlsym(mModuleHandle.get(), symbol.c_str());
+#endif
+}
+
+uintptr_t SignatureScanner::FindFunction(uint64_t fingerprint) const {
+  const FingerprintIndex::Function* function =
+    this->GetFingerprintIndex().Find(fingerprint);
+
+  return (function != nullptr) ? mBaseAddress + function->offset : 0;
+}
+
+uintptr_t SignatureScanner::FindVtable(const std::string& className) const {
+  const VtableIndex::Vtable* vtable =
+    this->GetVtableIndex().Find(VtableIndex::MangleName(className));
+
+  return (vtable != nullptr) ? vtable->address : 0;
+}
+
+std::shared_ptr<const ByteProfile> SignatureScanner::GetCachedByteProfile() const {
+  std::lock_guard<std::mutex> lock(mCache->mutex);
+  return mCache->profile;
+}
+
+const ByteProfile& SignatureScanner::GetByteProfile() const {
+  if(std::shared_ptr<const ByteProfile> profile = this->GetCachedByteProfile()) {
+    return *profile;
   }
 
-  mModuleHandle.reset(module, +[](void* handle) {
-    if(handle != nullptr) { FreeLibrary(handle); }
+  // The module is profiled without holding the lock, so searches meanwhile
+  // proceed (with the static profile); the first profile published wins
+  std::shared_ptr<ByteProfile> profile = std::make_shared<ByteProfile>();
+
+  this->ForEachRegion(
+      mBaseAddress,
+      mBaseAddress + mModuleSize,
+      [&](const byte* begin, const byte* end) {
+    profile->Add(begin, end - begin);
+    return true;
   });
 
-  MODULEINFO* moduleInfo;
-  if(!GetModuleInformation(
-      GetCurrentProcess(),
-      module,
-      &moduleInfo,
-      sizeof(MODULEINFO))) {
-    throw Exception("couldn't retrieve module information");
+  std::lock_guard<std::mutex> lock(mCache->mutex);
+  if(!mCache->profile) {
+    mCache->profile = profile;
   }
 
-  mBaseAddress  = reinterpret_cast<uintptr_t>(moduleInfo.lpBaseOfDll);
-  mModuleSize   = moduleInfo.SizeOfImage;
+  return *mCache->profile;
+}
+
+std::shared_ptr<const SignatureScanner::RegionList>
+SignatureScanner::GetAccessibleRegions() const {
+  std::lock_guard<std::mutex> lock(mCache->mutex);
+
+  if(!mCache->regions) {
+    std::shared_ptr<RegionList> regions = std::make_shared<RegionList>();
+
+    this->ForEachRegion(
+        mBaseAddress,
+        mBaseAddress + mModuleSize,
+        [&](const byte* begin, const byte* end) {
+      const uintptr_t lower = reinterpret_cast<uintptr_t>(begin);
+      const uintptr_t upper = reinterpret_cast<uintptr_t>(end);
+
+      // Adjacent regions are merged, so reads may span them
+      if(!regions->empty() && regions->back().second == lower) {
+        regions->back().second = upper;
+      } else {
+        regions->push_back(std::make_pair(lower, upper));
+      }
+
+      return true;
+    });
+
+    mCache->regions = regions;
+  }
+
+  return mCache->regions;
+}
+
+std::shared_ptr<const SignatureScanner::RegionList>
+SignatureScanner::GetSearchableRegions() const {
+  std::lock_guard<std::mutex> lock(mCache->mutex);
+
+  if(!mCache->searchable) {
+    std::shared_ptr<RegionList> regions = std::make_shared<RegionList>();
+
+    this->ForEachRegion(
+        mBaseAddress,
+        mBaseAddress + mModuleSize,
+        [&](const byte* begin, const byte* end) {
+      regions->push_back(std::make_pair(
+        reinterpret_cast<uintptr_t>(begin),
+        reinterpret_cast<uintptr_t>(end)));
+      return true;
+    });
+
+    mCache->searchable = regions;
+  }
+
+  return mCache->searchable;
+}
+
+bool SignatureScanner::Resolve(const Resolver& resolver, uintptr_t match, uintptr_t* result) const {
+  assert(result != nullptr);
+  return ResolveMatch(resolver, *this->GetAccessibleRegions(), match, result);
+}
+
+const RelocationMap& SignatureScanner::GetRelocationMap() const {
+  std::lock_guard<std::mutex> lock(mCache->mutex);
+
+  if(!mCache->relocations) {
+    std::shared_ptr<RelocationMap> relocations =
+      std::make_shared<RelocationMap>(mBaseAddress, mModuleSize);
+
+    this->LoadRelocations(relocations.get());
+    mCache->relocations = relocations;
+  }
+
+  return *mCache->relocations;
+}
+
+const VtableIndex& SignatureScanner::GetVtableIndex() const {
+  {
+    std::lock_guard<std::mutex> lock(mCache->mutex);
+
+    if(mCache->vtables) {
+      return *mCache->vtables;
+    }
+  }
+
+  // The index is built without holding the lock, since it requires the
+  // accessible regions; a concurrently built index is simply discarded.
+  std::shared_ptr<VtableIndex> vtables = std::make_shared<VtableIndex>();
+  this->LoadVtables(vtables.get());
+
+  std::lock_guard<std::mutex> lock(mCache->mutex);
+
+  if(!mCache->vtables) {
+    mCache->vtables = vtables;
+  }
+
+  return *mCache->vtables;
+}
+
+void SignatureScanner::LoadVtables(VtableIndex* vtables) const {
+  assert(vtables != nullptr);
+
+#ifdef _WIN32
+  throw Exception("virtual table discovery requires the Itanium ABI");
 #else /* POSIX */
-  Dl_info info;
-  if(!dladdr(containedAddress, &info)) {
-    throw Exception("couldn't retrieve memory information from address");
+  uintptr_t bias = 0;
+  const ElfW(Phdr)* relroHeader = FindProgramHeader(mBaseAddress, PT_GNU_RELRO, &bias);
+
+  if(relroHeader == nullptr) {
+    return;
   }
 
-  mModuleHandle.reset(dlopen(info.dli_fname, RTLD_NOW), +[](void* handle) {
-    if(handle != nullptr) { dlclose(handle); }
+  std::shared_ptr<const RegionList> readable = this->GetAccessibleRegions();
+  RegionList executable;
+
+  this->ForEachRegion(
+      mBaseAddress,
+      mBaseAddress + mModuleSize,
+      [&](const byte* begin, const byte* end) {
+    executable.push_back(std::make_pair(
+      reinterpret_cast<uintptr_t>(begin),
+      reinterpret_cast<uintptr_t>(end)));
+    return true;
+  }, ExecutableRegion);
+
+  // Objects larger than this are not expected to have secondary tables
+  const ptrdiff_t maxOffsetToTop = 1 << 24;
+  const uintptr_t alignment = sizeof(uintptr_t);
+
+  this->ForEachRegion(
+      bias + relroHeader->p_vaddr,
+      bias + relroHeader->p_vaddr + relroHeader->p_memsz,
+      [&](const byte* begin, const byte* end) {
+    const uintptr_t first =
+      (reinterpret_cast<uintptr_t>(begin) + alignment - 1) & ~(alignment - 1);
+    const uintptr_t* slots = reinterpret_cast<const uintptr_t*>(first);
+    const size_t count = (reinterpret_cast<uintptr_t>(end) > first) ?
+      (reinterpret_cast<uintptr_t>(end) - first) / alignment : 0;
+
+    for(size_t i = 0; (i + 2) < count;) {
+      const ptrdiff_t offsetToTop = static_cast<ptrdiff_t>(slots[i]);
+      const uintptr_t typeInfo = slots[i + 1];
+      size_t functions = 0;
+
+      if(offsetToTop <= 0 && offsetToTop > -maxOffsetToTop) {
+        while((i + 2 + functions) < count &&
+            GetReadableSize(executable, slots[i + 2 + functions]) > 0) {
+          functions++;
+        }
+      }
+
+      // Unnamed tables (without RTTI) can only be primary tables
+      std::string name;
+      if(functions == 0 || (typeInfo != 0 ?
+          !ReadTypeName(*readable, typeInfo, &name) : offsetToTop != 0)) {
+        i++;
+        continue;
+      }
+
+      vtables->Add({
+        reinterpret_cast<uintptr_t>(&slots[i + 2]),
+        offsetToTop,
+        typeInfo,
+        functions,
+        name
+      });
+
+      i += 2 + functions;
+    }
+
+    return true;
   });
+#endif
+}
 
-  if(!mModuleHandle) {
-    throw Exception("couldn't open module handle");
+const FunctionIndex& SignatureScanner::GetFunctionIndex() const {
+  std::lock_guard<std::mutex> lock(mCache->mutex);
+
+  if(!mCache->functions) {
+    std::shared_ptr<FunctionIndex> functions = std::make_shared<FunctionIndex>();
+
+    this->LoadFunctions(functions.get());
+    mCache->functions = functions;
   }
 
-  mBaseAddress = reinterpret_cast<uintptr_t>(info.dli_fbase);
-  mModuleSize  = this->CalculateModuleSize(info.dli_fbase);
+  return *mCache->functions;
+}
+
+void SignatureScanner::LoadFunctions(FunctionIndex* functions) const {
+  assert(functions != nullptr);
+
+  // Function chunks (e.g cold paths) are indexed as functions of their own
+  auto add = [&](uintptr_t address, size_t size) {
+    const std::vector<FunctionIndex::Function>& indexed = functions->GetFunctions();
+
+    if(size > 0 && (indexed.empty() ||
+        (indexed.back().address + indexed.back().size) <= address)) {
+      functions->Add({ address, size });
+    }
+  };
+
+#ifdef _WIN32
+# if defined(_M_X64) || defined(__x86_64__)
+  const IMAGE_DOS_HEADER* dosHeader =
+    reinterpret_cast<const IMAGE_DOS_HEADER*>(mBaseAddress);
+  const IMAGE_NT_HEADERS* ntHeaders =
+    reinterpret_cast<const IMAGE_NT_HEADERS*>(mBaseAddress + dosHeader->e_lfanew);
+
+  if(dosHeader->e_magic != IMAGE_DOS_SIGNATURE ||
+      ntHeaders->Signature != IMAGE_NT_SIGNATURE) {
+    throw Exception("couldn't find module headers");
+  }
+
+  const IMAGE_DATA_DIRECTORY& directory =
+    ntHeaders->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXCEPTION];
+  const RUNTIME_FUNCTION* entries =
+    reinterpret_cast<const RUNTIME_FUNCTION*>(mBaseAddress + directory.VirtualAddress);
+  const size_t count = directory.Size / sizeof(RUNTIME_FUNCTION);
+
+  for(size_t i = 0; directory.VirtualAddress != 0 && i < count; i++) {
+    add(mBaseAddress + entries[i].BeginAddress,
+      entries[i].EndAddress - entries[i].BeginAddress);
+  }
+# else
+  throw Exception("function discovery requires x64 unwind information");
+# endif
+#else /* POSIX */
+  uintptr_t bias = 0;
+  const ElfW(Phdr)* frameHeader = FindProgramHeader(mBaseAddress, PT_GNU_EH_FRAME, &bias);
+
+  if(frameHeader == nullptr) {
+    return;
+  }
+
+  // The header consists of a version, the encodings of the frame section
+  // pointer, the entry count and the search table, and their values.
+  const byte* header = reinterpret_cast<const byte*>(bias + frameHeader->p_vaddr);
+  const uintptr_t dataBase = reinterpret_cast<uintptr_t>(header);
+  const byte* position = header + 4;
+  uintptr_t frames, count;
+
+  if(header[0] != 1 ||
+      !ReadEncodedPointer(&position, header[1], dataBase, &frames) ||
+      !ReadEncodedPointer(&position, header[2], dataBase, &count)) {
+    throw Exception("couldn't parse module unwind information");
+  }
+
+  // The table pairs the start of each function with its frame description
+  // entry, which in turn describes the function's size.
+  std::unordered_map<const byte*, byte> encodings;
+
+  for(uintptr_t i = 0; i < count; i++) {
+    uintptr_t address, entry;
+
+    if(!ReadEncodedPointer(&position, header[3], dataBase, &address) ||
+        !ReadEncodedPointer(&position, header[3], dataBase, &entry)) {
+      throw Exception("couldn't parse module unwind information");
+    }
+
+    const byte* field = reinterpret_cast<const byte*>(entry) + 4;
+    if(*reinterpret_cast<const uint32_t*>(entry) == 0xFFFFFFFF) {
+      field += 8;
+    }
+
+    // The common information entry is located relative to its pointer
+    const byte* common = field - *reinterpret_cast<const uint32_t*>(field);
+    auto encoding = encodings.find(common);
+
+    if(encoding == encodings.end()) {
+      byte value;
+      if(!ReadFrameEncoding(common, &value)) {
+        continue;
+      }
+
+      encoding = encodings.insert(std::make_pair(common, value)).first;
+    }
+
+    // The size is encoded in the format of the start, without application
+    const byte* range = field + 4;
+    uintptr_t start, size;
+
+    if(!ReadEncodedPointer(&range, encoding->second, dataBase, &start) ||
+        !ReadEncodedPointer(&range, encoding->second & 0x0F, dataBase, &size)) {
+      continue;
+    }
+
+    add(address, size);
+  }
 #endif
 }
 
-uintptr_t SignatureScanner::FindSignature(
-    const std::vector<byte>& signature,
-    const char* mask,
-    size_t offset /*= 0*/,
-    size_t length /*= npos*/) const {
-  assert(mask != nullptr);
-  assert(signature.size() == strlen(mask));
+const FingerprintIndex& SignatureScanner::GetFingerprintIndex(
+    const std::string& directory /*= std::string()*/) const {
+  {
+    std::lock_guard<std::mutex> lock(mCache->mutex);
 
-  uintptr_t start = mBaseAddress + offset;
-  uintptr_t end = mBaseAddress + std::min(mModuleSize, length);
+    if(mCache->fingerprints) {
+      return *mCache->fingerprints;
+    }
+  }
 
-  assert(start < end);
+  const std::string buildId = this->GetBuildId();
+  const std::string path = (directory.empty() || buildId.empty()) ?
+    std::string() : directory + "/" + buildId + ".fingerprints";
 
-  MemoryInformation memoryInfo;
-  size_t x = 0;
+  // The index is built without holding the lock, since it requires the
+  // function index; a concurrently built index is simply discarded.
+  std::shared_ptr<FingerprintIndex> fingerprints = std::make_shared<FingerprintIndex>(buildId);
+  std::ifstream input;
 
-  while(start < end) {
-    size_t region = 0;
-    this->GetMemoryInfo(reinterpret_cast<void*>(start), &memoryInfo);
+  if(!path.empty()) {
+    input.open(path.c_str(), std::ios::binary);
+  }
 
-    // Calculate the bounds for the current memory region
-    region = reinterpret_cast<uintptr_t>(memoryInfo.baseAddress) +
-      memoryInfo.regionSize;
+  if(!input.is_open() ||
+      !FingerprintIndex::Load(input, fingerprints.get()) ||
+      fingerprints->GetBuildId() != buildId) {
+    fingerprints = std::make_shared<FingerprintIndex>(buildId);
+    this->LoadFingerprints(fingerprints.get());
+
+    if(!path.empty()) {
+      std::ofstream output(path.c_str(), std::ios::binary | std::ios::trunc);
+      fingerprints->Save(output);
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(mCache->mutex);
+
+  if(!mCache->fingerprints) {
+    mCache->fingerprints = fingerprints;
+  }
+
+  return *mCache->fingerprints;
+}
+
+void SignatureScanner::LoadFingerprints(FingerprintIndex* fingerprints) const {
+  assert(fingerprints != nullptr);
+
+  const FunctionIndex& functions = this->GetFunctionIndex();
+  std::shared_ptr<const RegionList> readable = this->GetAccessibleRegions();
+
+  // Modules without relocation tables (e.g static executables) have no
+  // relocated bytes to normalize.
+  const RelocationMap* relocations = nullptr;
+
+  try {
+    relocations = &this->GetRelocationMap();
+  } catch(const Exception&) {
+  }
 
-    if(!this->IsMemoryAccessible(memoryInfo)) {
-      start = region;
-      x = 0;
+  std::vector<byte> masks;
 
+  for(const FunctionIndex::Function& function : functions.GetFunctions()) {
+    if(GetReadableSize(*readable, function.address) < function.size) {
       continue;
     }
 
-    for(bool quit = false; start < region && !quit; start++) {
-      for(; x < signature.size(); x++) {
-        // Ensure that we aren't intruding in a new memory region
-        if((start + x) >= region) {
-          // We must decrement 'x', otherwise it might equal 'signature.size()'
-          // and we 'think' we have a match
-          quit = true;
-          x--;
+    const byte* code = reinterpret_cast<const byte*>(function.address);
+    const uintptr_t end = function.address + function.size;
+    masks.assign(function.size, 0xFF);
 
-          break;
-        }
+    for(uintptr_t relocated = relocations ? relocations->FindNext(function.address, end) : 0;
+        relocated != 0;
+        relocated = relocations->FindNext(relocated + 1, end)) {
+      masks[relocated - function.address] = 0x00;
+    }
 
-        // Exit the loop if the signature did not match with the source
-        if(mask[x] != '?' && signature[x] != reinterpret_cast<byte*>(start)[x]) {
-          break;
-        }
-      }
+    // Relative operands referring to the module change whenever the code or
+    // data in between does.
+    for(size_t i = 0; (i + sizeof(int32_t)) <= function.size;) {
+      const byte* operand = code + i;
+      const uintptr_t destination = ReferenceSearch::GetDestination(operand);
 
-      // If the increment count equals the signature length,
-      // we know we have a match!
-      if(x == signature.size()) {
-        return start;
+      if(destination >= mBaseAddress &&
+          destination < (mBaseAddress + mModuleSize) &&
+          ReferenceSearch::GetInstruction(code, operand) != nullptr) {
+        memset(&masks[i], 0x00, sizeof(int32_t));
+        i += sizeof(int32_t);
       } else {
-        x = 0;
+        i++;
       }
     }
-  }
 
-  return 0;
+    fingerprints->Add({
+      FingerprintIndex::Fingerprint(code, masks.data(), function.size),
+      function.address - mBaseAddress,
+      function.size
+    });
+  }
 }
 
-void* SignatureScanner::FindSymbol(const std::string& symbol) const {
+std::string SignatureScanner::GetBuildId() const {
+  const byte* id = nullptr;
+  size_t size = 0;
+
 #ifdef _WIN32
-  return GetProcAddress(mModuleHandle.get(), symbol.c_str());
+  const IMAGE_DOS_HEADER* dosHeader =
+    reinterpret_cast<const IMAGE_DOS_HEADER*>(mBaseAddress);
+  const IMAGE_NT_HEADERS* ntHeaders =
+    reinterpret_cast<const IMAGE_NT_HEADERS*>(mBaseAddress + dosHeader->e_lfanew);
+
+  if(dosHeader->e_magic != IMAGE_DOS_SIGNATURE ||
+      ntHeaders->Signature != IMAGE_NT_SIGNATURE) {
+    throw Exception("couldn't find module headers");
+  }
+
+  const IMAGE_DATA_DIRECTORY& directory =
+    ntHeaders->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_DEBUG];
+  const IMAGE_DEBUG_DIRECTORY* entries =
+    reinterpret_cast<const IMAGE_DEBUG_DIRECTORY*>(mBaseAddress + directory.VirtualAddress);
+  const size_t count = directory.Size / sizeof(IMAGE_DEBUG_DIRECTORY);
+
+  // The CodeView record ('RSDS') holds the PDB GUID followed by its age
+  for(size_t i = 0; directory.VirtualAddress != 0 && i < count; i++) {
+    const byte* record = reinterpret_cast<const byte*>(mBaseAddress + entries[i].AddressOfRawData);
+
+    if(entries[i].Type == IMAGE_DEBUG_TYPE_CODEVIEW &&
+        entries[i].AddressOfRawData != 0 &&
+        entries[i].SizeOfData >= 24 &&
+        memcmp(record, "RSDS", 4) == 0) {
+      id = record + 4;
+      size = 20;
+      break;
+    }
+  }
 #else /* POSIX */
-  return dlsym(mModuleHandle.get(), symbol.c_str());
+  if(!ReadBuildId(mBaseAddress, &id, &size)) {
+    return std::string();
+  }
 #endif
+
+  const char digits[] = "0123456789abcdef";
+  std::string result;
+
+  for(size_t i = 0; id != nullptr && i < size; i++) {
+    result += digits[id[i] >> 4];
+    result += digits[id[i] & 0xF];
+  }
+
+  return result;
 }
 
 void SignatureScanner::GetMemoryInfo(
@@ -141,6 +2206,7 @@ void SignatureScanner::GetMemoryInfo(
     MemoryInformation* memoryInfo) const {
   assert(memoryInfo != nullptr);
   assert(address != nullptr);
+  Tracer::Scope scope("region lookup");
 
 #ifdef _WIN32
   MEMORY_BASIC_INFORMATION memoryBasicInformation;
@@ -165,7 +2231,7 @@ void SignatureScanner::GetMemoryInfo(
     throw Exception("couldn't open memory mapping information file");
   }
 
-  char protection[4];
+  char protection[5];
   uintptr_t lower, upper;
   bool found = false;
 
@@ -184,7 +2250,7 @@ void SignatureScanner::GetMemoryInfo(
       memoryInfo->protection = 0;
       memoryInfo->state = 0;
 
-      for(uint i = 0; i < GetArraySize(protection); i++) {
+      for(uint i = 0; i < GetArraySize(protection) - 1; i++) {
         switch(protection[i]) {
         default: assert(false);
         case 'r': memoryInfo->protection |= PROT_READ; break;
@@ -207,6 +2273,7 @@ void SignatureScanner::GetMemoryInfo(
 #ifndef _WIN32
 size_t SignatureScanner::CalculateModuleSize(const void* baseAddress) const {
   assert(baseAddress != nullptr);
+  Tracer::Scope scope("module size");
 
   std::ifstream fstream("/proc/self/maps");
   std::string input;
@@ -218,15 +2285,15 @@ size_t SignatureScanner::CalculateModuleSize(const void* baseAddress) const {
   bool found = false;
   uintptr_t address = reinterpret_cast<uintptr_t>(baseAddress);
   uintptr_t lower, upper, offset;
-  char permissions[4];
+  char permissions[5];
   byte major, minor;
-  uint inode;
+  ulong inode;
 
   uintptr_t moduleBase, moduleEnd;
-  uint moduleNode;
+  ulong moduleNode;
 
   while(std::getline(fstream, input)) {
-    if(sscanf(input.c_str(), "%lx-%lx %s %lx %hhu:%hhu %du",
+    if(sscanf(input.c_str(), "%lx-%lx %s %lx %hhx:%hhx %lu",
         &lower, &upper, permissions, &offset, &major, &minor, &inode) != 7) {
       continue;
     }
@@ -284,4 +2351,38 @@ bool SignatureScanner::IsMemoryAccessible(
 #endif
 }
 
+bool SignatureScanner::IsMemoryEligible(
+    const MemoryInformation& memoryInfo,
+    uint regionFlags) const {
+  if(!this->IsMemoryAccessible(memoryInfo)) {
+    return false;
+  }
+
+#ifdef _WIN32
+  const ulong Executable =
+    PAGE_EXECUTE_READ      |
+    PAGE_EXECUTE_READWRITE |
+    PAGE_EXECUTE_WRITECOPY;
+
+  const ulong Writable =
+    PAGE_EXECUTE_READWRITE |
+    PAGE_EXECUTE_WRITECOPY |
+    PAGE_WRITECOPY         |
+    PAGE_READWRITE;
+#else /* POSIX */
+  const ulong Executable = PROT_EXEC;
+  const ulong Writable = PROT_WRITE;
+#endif
+
+  if((regionFlags & ExecutableRegion) && !(memoryInfo.protection & Executable)) {
+    return false;
+  }
+
+  if((regionFlags & WritableRegion) && !(memoryInfo.protection & Writable)) {
+    return false;
+  }
+
+  return !((regionFlags & ReadOnlyRegion) && (memoryInfo.protection & Writable));
+}
+
 /* vim: set ts=2 sw=2 expandtab: */
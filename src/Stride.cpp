@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cstring>
+
+#include "Bits.hpp"
+#include "Cpu.hpp"
+#include "Stride.hpp"
+
+namespace {
+/* The largest alignment whose eight window offsets fit a gather index */
+const size_t MaxGatherAlignment = INT_MAX / 8;
+
+#if SCANNER_X86_DISPATCH
+/* Find the first group of eight positions with a matching window
+ *
+ * Groups are tested while their last position is at most <last>. Returns
+ * the first position of the group with the matching positions in <hits> (one
+ * bit each), or the first untested position with <hits> set to zero.
+ */
+SCANNER_TARGET("avx2")
+const byte* GatherWindows(
+    const byte* position,
+    const byte* last,
+    size_t alignment,
+    size_t offset,
+    uint32_t value,
+    uint32_t mask,
+    uint32_t* hits) {
+  const int stride = static_cast<int>(alignment);
+  const __m256i indexes = _mm256_setr_epi32(
+    0, stride, stride * 2, stride * 3, stride * 4, stride * 5, stride * 6, stride * 7);
+  const __m256i values = _mm256_set1_epi32(static_cast<int>(value));
+  const __m256i masks = _mm256_set1_epi32(static_cast<int>(mask));
+
+  for(; position <= last && static_cast<size_t>(last - position) >= alignment * 7;
+      position += alignment * 8) {
+    const __m256i windows = _mm256_i32gather_epi32(
+      reinterpret_cast<const int*>(position + offset), indexes, 1);
+    const int matches = _mm256_movemask_ps(_mm256_castsi256_ps(
+      _mm256_cmpeq_epi32(_mm256_and_si256(windows, masks), values)));
+
+    if(matches != 0) {
+      *hits = static_cast<uint32_t>(matches);
+      return position;
+    }
+  }
+
+  *hits = 0;
+  return position;
+}
+#endif
+}
+
+Stride::Stride(const Signature& signature) :
+    mSignature(signature),
+    mWindowOffset(0),
+    mWindowLength(std::min<size_t>(signature.GetSize(), sizeof(uint32_t))),
+    mWindowValue(0),
+    mWindowMask(0)
+{
+  assert(signature.GetSize() > 0);
+
+  const byte* values = signature.GetValues();
+  const byte* masks = signature.GetMasks();
+
+  // The window comparing the most bits is the most selective
+  size_t best = 0;
+
+  for(size_t offset = 0; (offset + mWindowLength) <= signature.GetSize(); offset++) {
+    size_t bits = 0;
+
+    for(size_t i = 0; i < mWindowLength; i++) {
+      for(byte mask = masks[offset + i]; mask != 0; mask &= mask - 1) {
+        bits++;
+      }
+    }
+
+    if(bits > best) {
+      mWindowOffset = offset;
+      best = bits;
+    }
+  }
+
+  byte windowValues[sizeof(uint32_t)] = {};
+  byte windowMasks[sizeof(uint32_t)] = {};
+
+  memcpy(windowValues, values + mWindowOffset, mWindowLength);
+  memcpy(windowMasks, masks + mWindowOffset, mWindowLength);
+  memcpy(&mWindowValue, windowValues, sizeof(mWindowValue));
+  memcpy(&mWindowMask, windowMasks, sizeof(mWindowMask));
+}
+
+uint32_t Stride::ReadWindow(const byte* position) const {
+  byte window[sizeof(uint32_t)] = {};
+  memcpy(window, position + mWindowOffset, mWindowLength);
+
+  uint32_t result;
+  memcpy(&result, window, sizeof(result));
+  return result;
+}
+
+const byte* Stride::Find(
+    const byte* begin,
+    const byte* end,
+    ScanStatistics::Counters* counters /*= nullptr*/) const {
+  const size_t size = mSignature.GetSize();
+
+  if(static_cast<size_t>(end - begin) < size) {
+    return nullptr;
+  }
+
+  const size_t alignment = mSignature.GetAlignment();
+  const size_t misalignment = reinterpret_cast<uintptr_t>(begin) % alignment;
+  const size_t skipped =
+    (mSignature.GetAlignmentRemainder() + alignment - misalignment) % alignment;
+
+  // The last position that a match may start at
+  const byte* last = end - size;
+
+  if(skipped > static_cast<size_t>(last - begin)) {
+    return nullptr;
+  }
+
+  auto verify = [&](const byte* candidate) {
+    if(counters != nullptr) {
+      counters->candidates++;
+      counters->verifications++;
+    }
+
+    return mSignature.Matches(candidate);
+  };
+
+  const byte* position = begin + skipped;
+
+#if SCANNER_X86_DISPATCH
+  if(mWindowLength == sizeof(uint32_t) && alignment <= MaxGatherAlignment && Cpu::HasAvx2()) {
+    for(;;) {
+      uint32_t hits;
+      position = GatherWindows(
+        position, last, alignment, mWindowOffset, mWindowValue, mWindowMask, &hits);
+
+      if(hits == 0) {
+        break;
+      }
+
+      for(; hits != 0; hits &= hits - 1) {
+        const byte* candidate = position + Bits::CountTrailingZeros(hits) * alignment;
+
+        if(verify(candidate)) {
+          return candidate;
+        }
+      }
+
+      position += alignment * 8;
+    }
+
+    if(position > last) {
+      return nullptr;
+    }
+  }
+#endif
+
+  for(;;) {
+    if((ReadWindow(position) & mWindowMask) == mWindowValue && verify(position)) {
+      return position;
+    }
+
+    if(static_cast<size_t>(last - position) < alignment) {
+      return nullptr;
+    }
+
+    position += alignment;
+  }
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "Bits.hpp"
+#include "Cpu.hpp"
+#include "Teddy.hpp"
+
+namespace {
+/* Get the length of the run of complete bytes starting at an index */
+size_t GetRunLength(const Signature& signature, size_t index) {
+  size_t length = 0;
+
+  while((index + length) < signature.GetSize() && signature.GetMasks()[index + length] == 0xFF) {
+    length++;
+  }
+
+  return length;
+}
+
+/* Add the candidates of a vector result to the output */
+void AddCandidates(
+    const byte* position,
+    const uint8_t* buckets,
+    uint32_t lanes,
+    std::vector<Teddy::Candidate>* candidates) {
+  for(; lanes != 0; lanes &= lanes - 1) {
+    const size_t lane = Bits::CountTrailingZeros(lanes);
+    candidates->push_back(std::make_pair(position + lane, buckets[lane]));
+  }
+}
+
+#if SCANNER_X86_DISPATCH
+SCANNER_TARGET("avx2")
+const byte* FindAvx2(
+    const uint8_t (*lowMasks)[16],
+    const uint8_t (*highMasks)[16],
+    size_t length,
+    const byte* position,
+    const byte* end,
+    std::vector<Teddy::Candidate>* candidates) {
+  const __m256i nibble = _mm256_set1_epi8(0x0F);
+  __m256i low[Teddy::MaxFragmentLength], high[Teddy::MaxFragmentLength];
+
+  // The shuffle operates within each 128-bit lane, so the tables are repeated
+  for(size_t j = 0; j < length; j++) {
+    low[j] = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(lowMasks[j])));
+    high[j] = _mm256_broadcastsi128_si256(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(highMasks[j])));
+  }
+
+  alignas(32) uint8_t buckets[32];
+
+  for(; static_cast<size_t>(end - position) >= (32 + length - 1); position += 32) {
+    __m256i result = _mm256_set1_epi8(-1);
+
+    for(size_t j = 0; j < length; j++) {
+      const __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(position + j));
+
+      result = _mm256_and_si256(result, _mm256_and_si256(
+        _mm256_shuffle_epi8(low[j], _mm256_and_si256(data, nibble)),
+        _mm256_shuffle_epi8(high[j], _mm256_and_si256(_mm256_srli_epi16(data, 4), nibble))));
+    }
+
+    const uint32_t lanes = ~static_cast<uint32_t>(_mm256_movemask_epi8(
+      _mm256_cmpeq_epi8(result, _mm256_setzero_si256())));
+
+    if(lanes != 0) {
+      _mm256_store_si256(reinterpret_cast<__m256i*>(buckets), result);
+      AddCandidates(position, buckets, lanes, candidates);
+    }
+  }
+
+  return position;
+}
+
+SCANNER_TARGET("ssse3")
+const byte* FindSsse3(
+    const uint8_t (*lowMasks)[16],
+    const uint8_t (*highMasks)[16],
+    size_t length,
+    const byte* position,
+    const byte* end,
+    std::vector<Teddy::Candidate>* candidates) {
+  const __m128i nibble = _mm_set1_epi8(0x0F);
+  __m128i low[Teddy::MaxFragmentLength], high[Teddy::MaxFragmentLength];
+
+  for(size_t j = 0; j < length; j++) {
+    low[j] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lowMasks[j]));
+    high[j] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(highMasks[j]));
+  }
+
+  alignas(16) uint8_t buckets[16];
+
+  for(; static_cast<size_t>(end - position) >= (16 + length - 1); position += 16) {
+    __m128i result = _mm_set1_epi8(-1);
+
+    for(size_t j = 0; j < length; j++) {
+      const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(position + j));
+
+      result = _mm_and_si128(result, _mm_and_si128(
+        _mm_shuffle_epi8(low[j], _mm_and_si128(data, nibble)),
+        _mm_shuffle_epi8(high[j], _mm_and_si128(_mm_srli_epi16(data, 4), nibble))));
+    }
+
+    const uint32_t lanes = ~static_cast<uint32_t>(_mm_movemask_epi8(
+      _mm_cmpeq_epi8(result, _mm_setzero_si128()))) & 0xFFFF;
+
+    if(lanes != 0) {
+      _mm_store_si128(reinterpret_cast<__m128i*>(buckets), result);
+      AddCandidates(position, buckets, lanes, candidates);
+    }
+  }
+
+  return position;
+}
+#endif
+}
+
+const size_t Teddy::BucketCount;
+const size_t Teddy::MaxFragmentLength;
+const size_t Teddy::MaxSignatures;
+
+Teddy::Teddy(
+    const std::vector<Signature>& signatures,
+    const std::vector<size_t>& members,
+    const ByteProfile& profile) :
+    mFragmentLength(MaxFragmentLength),
+    mMaxOffset(0),
+    mCount(0),
+    mOffsets(signatures.size(), 0),
+    mFragments(signatures.size(), 0),
+    mContained(signatures.size(), false)
+{
+  memset(mLowMasks, 0, sizeof(mLowMasks));
+  memset(mHighMasks, 0, sizeof(mHighMasks));
+
+  const std::vector<size_t> candidates(
+    members.begin(),
+    members.begin() + std::min(members.size(), MaxSignatures));
+
+  // The fragment length is shared, so it is limited by the shortest run
+  for(size_t i : candidates) {
+    const Signature& signature = signatures[i];
+    size_t longest = 0;
+
+    for(size_t position = 0; position < signature.GetSize(); position++) {
+      longest = std::max(longest, GetRunLength(signature, position));
+    }
+
+    if(longest >= 2) {
+      mFragmentLength = std::min(mFragmentLength, longest);
+    }
+  }
+
+  // Each signature uses its rarest run of complete bytes as fragment
+  std::vector<std::pair<std::vector<byte>, size_t>> fragments;
+
+  for(size_t i : candidates) {
+    const Signature& signature = signatures[i];
+    const byte* values = signature.GetValues();
+    double rarest = 2.0;
+    bool found = false;
+
+    for(size_t x = 0; (x + mFragmentLength) <= signature.GetSize(); x++) {
+      if(GetRunLength(signature, x) < mFragmentLength) {
+        continue;
+      }
+
+      double frequency = 1.0;
+      for(size_t j = 0; j < mFragmentLength; j++) {
+        frequency *= profile.GetByteFrequency(values[x + j]);
+      }
+
+      if(frequency < rarest) {
+        mOffsets[i] = x;
+        rarest = frequency;
+        found = true;
+      }
+    }
+
+    if(found) {
+      fragments.push_back(std::make_pair(std::vector<byte>(
+        values + mOffsets[i],
+        values + mOffsets[i] + mFragmentLength), i));
+      memcpy(&mFragments[i], values + mOffsets[i], mFragmentLength);
+      mContained[i] = true;
+      mMaxOffset = std::max(mMaxOffset, mOffsets[i]);
+    }
+  }
+
+  // Similar fragments share buckets, to reduce false positives
+  std::sort(fragments.begin(), fragments.end());
+  mCount = fragments.size();
+
+  for(size_t i = 0; i < fragments.size(); i++) {
+    const size_t bucket = (i * BucketCount) / fragments.size();
+    const std::vector<byte>& fragment = fragments[i].first;
+
+    mBuckets[bucket].push_back(fragments[i].second);
+
+    for(size_t j = 0; j < mFragmentLength; j++) {
+      mLowMasks[j][fragment[j] & 0xF] |= static_cast<uint8_t>(1 << bucket);
+      mHighMasks[j][fragment[j] >> 4] |= static_cast<uint8_t>(1 << bucket);
+    }
+  }
+}
+
+void Teddy::Find(
+    const byte* begin,
+    const byte* end,
+    std::vector<Candidate>* candidates) const {
+  assert(candidates != nullptr);
+
+  const byte* position = begin;
+
+#if SCANNER_X86_DISPATCH
+  if(Cpu::HasAvx2()) {
+    position = FindAvx2(mLowMasks, mHighMasks, mFragmentLength, position, end, candidates);
+  }
+
+  if(Cpu::HasSsse3()) {
+    position = FindSsse3(mLowMasks, mHighMasks, mFragmentLength, position, end, candidates);
+  }
+#endif
+
+  for(; static_cast<size_t>(end - position) >= mFragmentLength; position++) {
+    uint8_t buckets = 0xFF;
+
+    for(size_t j = 0; j < mFragmentLength; j++) {
+      buckets &= mLowMasks[j][position[j] & 0xF] & mHighMasks[j][position[j] >> 4];
+    }
+
+    if(buckets != 0) {
+      candidates->push_back(std::make_pair(position, buckets));
+    }
+  }
+}
+
+bool Teddy::IsSupported() {
+  return Cpu::HasSsse3();
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "ByteProfile.hpp"
+#include "Signature.hpp"
+
+/* Multi-literal prefilter
+ *
+ * Finds candidate positions of many signatures in a single pass, in the
+ * style of Hyperscan's Teddy. Each signature contributes a short fragment
+ * of complete bytes (up to three, the rarest such run), and the signatures
+ * are divided into eight buckets. For each fragment byte, two 16 entry
+ * tables map the low and high nibble of a byte to the buckets containing a
+ * fragment with that nibble; a byte shuffle (PSHUFB) performs the lookup
+ * for 16 or 32 positions at once. Positions where every fragment byte
+ * agrees on a bucket are candidates for the signatures of that bucket.
+ *
+ * Requires SSSE3 (see <IsSupported>).
+ */
+class Teddy {
+public:
+    /* A candidate fragment position and its buckets (one bit each) */
+    typedef std::pair<const byte*, uint8_t> Candidate;
+
+    /* Construct the prefilter
+     *
+     * Only signatures with at least two consecutive complete bytes can be
+     * prefiltered (see <Contains>). The candidates become less selective as
+     * the buckets grow, so at most <MaxSignatures> are prefiltered.
+     *
+     * @signatures The signatures of the batch.
+     *
+     * @members The indexes of the signatures to prefilter.
+     *
+     * @profile The profile used to select the fragments.
+     */
+    Teddy(
+        const std::vector<Signature>& signatures,
+        const std::vector<size_t>& members,
+        const ByteProfile& profile);
+
+    /* Find candidate fragment positions
+     *
+     * @begin The start of the memory block.
+     *
+     * @end The end of the memory block (exclusive). Fragments must reside
+     *      completely within the block.
+     *
+     * @candidates A vector receiving the candidates, in ascending order.
+     */
+    void Find(const byte* begin, const byte* end, std::vector<Candidate>* candidates) const;
+
+    /* Check if a signature is prefiltered */
+    bool Contains(size_t signature) const;
+
+    /* Get the offset of a signature's fragment within the signature */
+    size_t GetOffset(size_t signature) const;
+
+    /* Check if the fragment of a signature is located at a position
+     *
+     * @signature The index of a prefiltered signature.
+     *
+     * @position The (candidate) fragment position.
+     */
+    bool MatchesFragment(size_t signature, const byte* position) const;
+
+    /* Get the signatures of a bucket */
+    const std::vector<size_t>& GetBucket(size_t bucket) const;
+
+    /* Get the largest fragment offset of any prefiltered signature */
+    size_t GetMaxOffset() const;
+
+    /* Get the number of prefiltered signatures */
+    size_t GetCount() const;
+
+    /* Check if the CPU supports the prefilter */
+    static bool IsSupported();
+
+    /* The number of buckets */
+    static const size_t BucketCount = 8;
+
+    /* The maximum number of bytes in a fragment */
+    static const size_t MaxFragmentLength = 3;
+
+    /* The maximum number of prefiltered signatures */
+    static const size_t MaxSignatures = 8 * BucketCount;
+
+private:
+    // Private members
+    uint8_t mLowMasks[MaxFragmentLength][16];
+    uint8_t mHighMasks[MaxFragmentLength][16];
+    size_t mFragmentLength;
+    size_t mMaxOffset;
+    size_t mCount;
+    std::vector<size_t> mOffsets;
+    std::vector<uint32_t> mFragments;
+    std::vector<bool> mContained;
+    std::vector<size_t> mBuckets[BucketCount];
+};
+
+inline bool Teddy::Contains(size_t signature) const {
+  return mContained[signature];
+}
+
+inline size_t Teddy::GetOffset(size_t signature) const {
+  return mOffsets[signature];
+}
+
+inline bool Teddy::MatchesFragment(size_t signature, const byte* position) const {
+  uint32_t fragment = 0;
+  memcpy(&fragment, position, mFragmentLength);
+
+  return fragment == mFragments[signature];
+}
+
+inline const std::vector<size_t>& Teddy::GetBucket(size_t bucket) const {
+  return mBuckets[bucket];
+}
+
+inline size_t Teddy::GetMaxOffset() const {
+  return mMaxOffset;
+}
+
+inline size_t Teddy::GetCount() const {
+  return mCount;
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
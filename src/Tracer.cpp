@@ -0,0 +1,253 @@
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Tracer.hpp"
+
+namespace {
+/* A recorded event
+ *
+ * The sequence is the (one based) index of the event in its buffer, or zero
+ * while the event is being written, so readers can detect torn events.
+ */
+struct Event {
+  std::atomic<uint64_t> sequence;
+  std::atomic<const char*> name;
+  std::atomic<uint64_t> start;
+  std::atomic<uint64_t> duration;
+  std::atomic<uint64_t> argument;
+};
+
+/* The ring buffer of a thread, written by that thread only
+ *
+ * The events before the first index belong to a previous thread, whose
+ * events have already been drained (see <Drain>).
+ */
+struct Buffer {
+  Buffer(size_t capacity, unsigned int thread) :
+      events(new Event[capacity]()),
+      capacity(capacity),
+      head(0),
+      first(0),
+      thread(thread),
+      retired(false)
+  {
+  }
+
+  std::unique_ptr<Event[]> events;
+  size_t capacity;
+  std::atomic<uint64_t> head;
+  std::atomic<uint64_t> first;
+  std::atomic<unsigned int> thread;
+
+  // Whether the thread has exited (guarded by the registry)
+  bool retired;
+};
+
+/* The buffers of every thread that has recorded an event
+ *
+ * The buffer of an exited thread is retained until its events have been
+ * written or cleared, after which it is reused by the next thread to record
+ * an event. The number of buffers is thus bounded by the number of threads
+ * alive at once, plus those that exited since the events were last drained.
+ */
+struct Registry {
+  std::mutex mutex;
+  std::vector<std::shared_ptr<Buffer>> buffers;
+  std::vector<std::shared_ptr<Buffer>> drained;
+  size_t capacity = Tracer::DefaultCapacity;
+  unsigned int threads = 0;
+  std::atomic<uint64_t> cleared{0};
+};
+
+Registry& GetRegistry() {
+  static Registry registry;
+  return registry;
+}
+
+/* Make the buffer of an exited thread available for reuse (the registry
+ * must be locked). A buffer that is retired but not yet drained has events
+ * past its first index, since a thread claims a buffer to record one. */
+void Drain(Registry& registry, const std::shared_ptr<Buffer>& buffer) {
+  assert(buffer->retired);
+
+  buffer->first.store(buffer->head.load(std::memory_order_relaxed), std::memory_order_release);
+  registry.drained.push_back(buffer);
+}
+
+/* Owns the buffer of a thread, retiring it when the thread exits */
+struct BufferOwner {
+  ~BufferOwner() {
+    if(buffer) {
+      Registry& registry = GetRegistry();
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      buffer->retired = true;
+    }
+  }
+
+  std::shared_ptr<Buffer> buffer;
+};
+
+Buffer& GetThreadBuffer() {
+  thread_local BufferOwner owner;
+
+  if(!owner.buffer) {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    // Drained buffers of another capacity are released instead of reused
+    while(!registry.drained.empty() && !owner.buffer) {
+      std::shared_ptr<Buffer> buffer = registry.drained.back();
+      registry.drained.pop_back();
+
+      if(buffer->capacity == registry.capacity) {
+        owner.buffer = buffer;
+        owner.buffer->retired = false;
+        owner.buffer->thread.store(++registry.threads, std::memory_order_relaxed);
+      } else {
+        registry.buffers.erase(std::find(
+          registry.buffers.begin(),
+          registry.buffers.end(),
+          buffer));
+      }
+    }
+
+    if(!owner.buffer) {
+      owner.buffer = std::make_shared<Buffer>(registry.capacity, ++registry.threads);
+      registry.buffers.push_back(owner.buffer);
+    }
+  }
+
+  return *owner.buffer;
+}
+}
+
+std::atomic<bool> Tracer::mEnabled(false);
+
+void Tracer::Enable(size_t capacity /*= DefaultCapacity*/) {
+  Registry& registry = GetRegistry();
+  {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.capacity = std::max<size_t>(capacity, 1);
+  }
+
+  mEnabled.store(true);
+}
+
+void Tracer::Disable() {
+  mEnabled.store(false);
+}
+
+void Tracer::Clear() {
+  // Events are not removed, but those that started earlier are ignored
+  Registry& registry = GetRegistry();
+  registry.cleared.store(GetTimestamp());
+
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for(const std::shared_ptr<Buffer>& buffer : registry.buffers) {
+    if(buffer->retired &&
+        buffer->first.load(std::memory_order_relaxed) < buffer->head.load(std::memory_order_relaxed)) {
+      Drain(registry, buffer);
+    }
+  }
+}
+
+void Tracer::Record(const char* name, uint64_t start, uint64_t duration, uint64_t argument) {
+  Buffer& buffer = GetThreadBuffer();
+  const uint64_t index = buffer.head.load(std::memory_order_relaxed);
+  Event& event = buffer.events[index % buffer.capacity];
+
+  event.sequence.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  event.name.store(name, std::memory_order_relaxed);
+  event.start.store(start, std::memory_order_relaxed);
+  event.duration.store(duration, std::memory_order_relaxed);
+  event.argument.store(argument, std::memory_order_relaxed);
+
+  event.sequence.store(index + 1, std::memory_order_release);
+  buffer.head.store(index + 1, std::memory_order_release);
+}
+
+size_t Tracer::GetBufferCount() {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  return registry.buffers.size();
+}
+
+uint64_t Tracer::GetTimestamp() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void Tracer::WriteChromeTrace(std::ostream& stream) {
+  Registry& registry = GetRegistry();
+  std::vector<std::shared_ptr<Buffer>> buffers;
+  {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    buffers = registry.buffers;
+  }
+
+  const uint64_t cleared = registry.cleared.load();
+  std::vector<uint64_t> heads;
+  bool first = true;
+
+  stream << "{\"traceEvents\":[";
+
+  for(const std::shared_ptr<Buffer>& buffer : buffers) {
+    const uint64_t head = buffer->head.load(std::memory_order_acquire);
+    const uint64_t tail = std::max<uint64_t>(
+      buffer->first.load(std::memory_order_acquire),
+      (head > buffer->capacity) ? head - buffer->capacity : 0);
+    const unsigned int thread = buffer->thread.load(std::memory_order_relaxed);
+    heads.push_back(head);
+
+    for(uint64_t index = tail; index < head; index++) {
+      Event& event = buffer->events[index % buffer->capacity];
+
+      if(event.sequence.load(std::memory_order_acquire) != index + 1) {
+        continue;
+      }
+
+      const char* name = event.name.load(std::memory_order_relaxed);
+      const uint64_t start = event.start.load(std::memory_order_relaxed);
+      const uint64_t duration = event.duration.load(std::memory_order_relaxed);
+      const uint64_t argument = event.argument.load(std::memory_order_relaxed);
+
+      // The event is discarded if it was overwritten while being read
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if(event.sequence.load(std::memory_order_relaxed) != index + 1 || start < cleared) {
+        continue;
+      }
+
+      // Timestamps are in microseconds. Names are string literals of the
+      // scanner, which never require escaping.
+      stream << (first ? "" : ",")
+             << "{\"name\":\"" << name << "\",\"cat\":\"scanner\",\"ph\":\"X\""
+             << ",\"ts\":" << (start / 1000) << "." << (start % 1000) / 100
+             << ",\"dur\":" << (duration / 1000) << "." << (duration % 1000) / 100
+             << ",\"pid\":1,\"tid\":" << thread
+             << ",\"args\":{\"value\":" << argument << "}}";
+      first = false;
+    }
+  }
+
+  stream << "]}";
+
+  // The buffers of exited threads are reused once every event is written
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  for(size_t i = 0; i < buffers.size(); i++) {
+    const std::shared_ptr<Buffer>& buffer = buffers[i];
+
+    if(buffer->retired &&
+        buffer->head.load(std::memory_order_relaxed) == heads[i] &&
+        buffer->first.load(std::memory_order_relaxed) < heads[i]) {
+      Drain(registry, buffer);
+    }
+  }
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+
+#include "VtableIndex.hpp"
+
+void VtableIndex::Add(const Vtable& vtable) {
+  assert(mVtables.empty() || mVtables.back().address < vtable.address);
+
+  if(!vtable.name.empty()) {
+    mNames.insert(std::make_pair(vtable.name, mVtables.size()));
+  }
+
+  mVtables.push_back(vtable);
+}
+
+const VtableIndex::Vtable* VtableIndex::Find(const std::string& name) const {
+  const Vtable* result = nullptr;
+
+  for(const Vtable* vtable : this->FindAll(name)) {
+    if(vtable->offsetToTop == 0) {
+      return vtable;
+    }
+
+    // Without a primary table, the first secondary table is used
+    if(result == nullptr) {
+      result = vtable;
+    }
+  }
+
+  return result;
+}
+
+std::vector<const VtableIndex::Vtable*> VtableIndex::FindAll(const std::string& name) const {
+  std::vector<const Vtable*> results;
+  auto range = mNames.equal_range(name);
+
+  for(auto it = range.first; it != range.second; ++it) {
+    results.push_back(&mVtables[it->second]);
+  }
+
+  std::sort(results.begin(), results.end());
+  return results;
+}
+
+std::string VtableIndex::MangleName(const std::string& name) {
+  if(name.empty() || isdigit(static_cast<unsigned char>(name[0])) || name[0] == 'N') {
+    return name;
+  }
+
+  std::vector<std::string> parts;
+  for(size_t start = 0;;) {
+    size_t separator = name.find("::", start);
+    parts.push_back(name.substr(start, separator - start));
+
+    if(separator == std::string::npos) {
+      break;
+    }
+
+    start = separator + 2;
+  }
+
+  std::string result;
+  for(const std::string& part : parts) {
+    result += std::to_string(part.size()) + part;
+  }
+
+  return (parts.size() > 1) ? "N" + result + "E" : result;
+}
+
+/* vim: set ts=2 sw=2 expandtab: */
@@ -4,4 +4,59 @@
 
 int Add(int x, int y) {
   return x + y;
-}
\ No newline at end of file
+}
+
+const char* GetGreeting() {
+  return "Greetings from the signature scanner";
+}
+
+// The function pointer is patched by the dynamic loader
+// The non-relocated words outnumber any run of relocated ones (e.g virtual
+// tables), so that only the entry matches when relocated bytes are ignored
+static const Entry AddEntry = {
+  0x5E1A7EDC0FFEE5EDULL,
+  &Add,
+  {
+    0x7A11C0DEBAADF00DULL, 0x0DDBA11CAFEBABE5ULL, 0x5CA1AB1EDEADFA11ULL,
+    0x0B5E55EDFEEDFACEULL, 0x1CEB00DAC0DEDEADULL, 0x7EA5E1ECADDEDB0BULL,
+  },
+};
+
+const Entry* GetEntry() {
+  return &AddEntry;
+}
+
+// Two identical records, whose (relocated) function pointers are equal
+static const Twin Twins[] = {
+  { 0x7E1A7ED0D15EA5E5ULL, &Add },
+  { 0x7E1A7ED0D15EA5E5ULL, &Add },
+};
+
+const Twin* GetTwins() {
+  return Twins;
+}
+
+// A global pointer, null until it is set (e.g the local player of a game)
+static const void* LocalPlayer = nullptr;
+
+const void* GetLocalPlayer() {
+  return LocalPlayer;
+}
+
+void SetLocalPlayer(const void* player) {
+  LocalPlayer = player;
+}
+
+namespace {
+  // The class has internal linkage, thus no exported symbols
+  struct Square : public Shape {
+    explicit Square(int side) : mSide(side) {}
+    int GetArea() const override { return mSide * mSide; }
+
+    int mSide;
+  };
+}
+
+Shape* CreateSquare(int side) {
+  return new Square(side);
+}
@@ -1,3 +1,29 @@
 #pragma once
 
-extern "C" int Add(int x, int y);
\ No newline at end of file
+extern "C" int Add(int x, int y);
+extern "C" const char* GetGreeting();
+
+struct Entry {
+  unsigned long long head;
+  int (*function)(int, int);
+  unsigned long long tail[6];
+};
+
+extern "C" const Entry* GetEntry();
+
+struct Twin {
+  unsigned long long tag;
+  int (*function)(int, int);
+};
+
+extern "C" const Twin* GetTwins();
+
+extern "C" const void* GetLocalPlayer();
+extern "C" void SetLocalPlayer(const void* player);
+
+struct Shape {
+  virtual ~Shape() {}
+  virtual int GetArea() const = 0;
+};
+
+extern "C" Shape* CreateSquare(int side);
@@ -1,8 +1,25 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <thread>
 #include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
 
 #define CATCH_CONFIG_MAIN
 #include "catch.hpp"
 #include "library.hpp"
+#include "BasicScanner.hpp"
+#include "ResultCache.hpp"
+#include "SignaturePack.hpp"
+#include "SignatureScanner.hpp"
 
 namespace {
 typedef unsigned char byte;
@@ -19,16 +36,690 @@ TEST_CASE("scanner", "The signature scanner") {
   SECTION("local", "It finds the 'Add' function") {
     const size_t BytesToCompare = 10;
 
-    std::vector<byte> signature(BytesToCompare);
+    std::vector<byte> signature;
     std::string mask(BytesToCompare, 'x');
 
-    for(int i = 0; i < BytesToCompare; i++) {
+    for(size_t i = 0; i < BytesToCompare; i++) {
       signature.push_back(reinterpret_cast<byte*>(&Add)[i]);
     }
 
     REQUIRE(scanner.FindSignature(signature, mask.c_str()) == reinterpret_cast<uintptr_t>(&Add));
     mask[6] = '?';
     REQUIRE(scanner.FindSignature(signature, mask.c_str()) == reinterpret_cast<uintptr_t>(&Add));
-    REQUIRE(reinterpret_cast<decltype(&Foo)>(scanner.FindSignature(signature, mask.c_str()))(5, 6) == 11);
+    REQUIRE(reinterpret_cast<decltype(&Add)>(scanner.FindSignature(signature, mask.c_str()))(5, 6) == 11);
+  }
+
+  SECTION("views", "It finds the 'Add' function using pointers and bitmaps") {
+    const uintptr_t function = reinterpret_cast<uintptr_t>(&Add);
+    const byte* code = reinterpret_cast<const byte*>(&Add);
+    const byte masks[] = { 0xFF, 0xFF, 0x00, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+    const uint64_t bitmap[] = { 0x3FB };
+
+    REQUIRE(scanner.FindSignature(code, "xx?xxxxxxxIGNORED", 10) == function);
+    REQUIRE(scanner.FindSignature(code, masks, 10) == function);
+    REQUIRE(scanner.FindSignature(code, bitmap, 10) == function);
+    REQUIRE(Signature(code, bitmap, 10).ToString() == Signature(code, masks, 10).ToString());
+  }
+
+  SECTION("profile", "It finds the 'Add' function using a module profile") {
+    // Copies profiling concurrently publish (and return) a single profile
+    const SignatureScanner copy = scanner;
+    const ByteProfile* concurrent = nullptr;
+    std::thread profiler([&]() { concurrent = &copy.GetByteProfile(); });
+
+    const ByteProfile& profile = scanner.GetByteProfile();
+    profiler.join();
+    REQUIRE(concurrent == &profile);
+    REQUIRE(profile.GetByteCount() > 0);
+    REQUIRE(profile.GetByteCount() <= scanner.GetModuleSize());
+
+    std::vector<byte> signature(
+      reinterpret_cast<byte*>(&Add),
+      reinterpret_cast<byte*>(&Add) + 8);
+
+    REQUIRE(scanner.FindSignature(signature, "xx?xxxxx") == reinterpret_cast<uintptr_t>(&Add));
+  }
+  SECTION("nibble", "It finds the 'Add' function using bit masks") {
+    const byte* add = reinterpret_cast<byte*>(&Add);
+
+    std::vector<byte> values(add, add + 8);
+    std::vector<byte> masks(8, 0xFF);
+    masks[0] = 0xF0;
+    masks[3] = 0x38;
+
+    REQUIRE(scanner.FindSignature(Signature(values, masks)) == reinterpret_cast<uintptr_t>(&Add));
+
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "%X? ?%X %02X&F0 ? %02X",
+      add[0] >> 4, add[1] & 0xF, add[2], add[4]);
+    REQUIRE(Signature(pattern).GetSize() == 5);
+    REQUIRE(Signature(pattern).Matches(add));
+
+    REQUIRE_THROWS(Signature("4? 8G"));
+  }
+
+  SECTION("pattern", "It finds the 'Add' function using a pattern") {
+    const byte* add = reinterpret_cast<byte*>(&Add);
+
+    char text[128];
+    snprintf(text, sizeof(text), "(%02X %02X | FF FF) [0-2] {%02X 00} ? %02X",
+      add[0], add[1], add[3], add[5]);
+
+    Pattern pattern(text);
+    REQUIRE(pattern.GetMinLength() == 5);
+    REQUIRE(pattern.GetMaxLength() == 7);
+    const uintptr_t function = reinterpret_cast<uintptr_t>(&Add);
+    const size_t offset = function - reinterpret_cast<uintptr_t>(scanner.GetBaseAddress());
+    REQUIRE(scanner.FindPattern(pattern, offset) == function);
+    REQUIRE(scanner.FindPattern(pattern) != 0);
+    REQUIRE(scanner.FindPattern(pattern) <= function);
+    REQUIRE(pattern.Matches(add, add + 16) != nullptr);
+
+    REQUIRE_THROWS(Pattern("[0-4]"));
+    REQUIRE_THROWS(Pattern("(8B | 89"));
+  }
+
+  SECTION("relocations", "It ignores bytes patched by the loader") {
+    const RelocationMap& relocations = scanner.GetRelocationMap();
+    const Entry* addEntry = GetEntry();
+    const uintptr_t entry = reinterpret_cast<uintptr_t>(addEntry);
+
+    REQUIRE(relocations.GetCount() > 0);
+    REQUIRE_FALSE(relocations.IsRelocated(entry));
+    REQUIRE(relocations.IsRelocated(reinterpret_cast<uintptr_t>(&addEntry->function)));
+
+    // The relocated function pointer is replaced by garbage
+    std::vector<byte> signature(sizeof(Entry), 0xCC);
+    memcpy(&signature[0], &addEntry->head, sizeof(addEntry->head));
+    memcpy(&signature[offsetof(Entry, tail)], &addEntry->tail, sizeof(addEntry->tail));
+    std::string mask(signature.size(), 'x');
+
+    REQUIRE(scanner.FindSignature(signature, mask.c_str()) == 0);
+    REQUIRE(scanner.FindSignature(signature, mask.c_str(), 0,
+      SignatureScanner::npos, SignatureScanner::IgnoreRelocations) == entry);
+  }
+
+  SECTION("resolver", "It resolves matches") {
+    const Entry* addEntry = GetEntry();
+
+    std::vector<byte> values(
+      reinterpret_cast<const byte*>(&addEntry->head),
+      reinterpret_cast<const byte*>(&addEntry->head) + sizeof(addEntry->head));
+    Signature signature(values, std::string(values.size(), 'x').c_str());
+
+    Resolver resolver;
+    resolver.Offset(offsetof(Entry, function)).Dereference();
+
+    REQUIRE(scanner.FindSignature(signature, resolver) == reinterpret_cast<uintptr_t>(&Add));
+    REQUIRE(scanner.FindAllSignatures(signature, resolver).back() == reinterpret_cast<uintptr_t>(&Add));
+
+    std::vector<Signature> signatures(2, signature);
+    std::vector<uintptr_t> results = scanner.FindSignatures(signatures);
+    REQUIRE(results.size() == 2);
+    REQUIRE(results[0] == scanner.FindSignature(signature));
+    REQUIRE(results[1] == results[0]);
+
+    // Reads outside of the module cannot be resolved
+    resolver.Offset(scanner.GetModuleSize()).Dereference();
+    REQUIRE(scanner.FindSignature(signature, resolver) == 0);
+  }
+
+  SECTION("references", "It finds the instruction referring to the entry") {
+    const uintptr_t entry = reinterpret_cast<uintptr_t>(GetEntry());
+    const uintptr_t function = reinterpret_cast<uintptr_t>(&GetEntry);
+
+    std::vector<uintptr_t> references = scanner.FindReferences(entry);
+    REQUIRE(references.size() == 1);
+    REQUIRE(references[0] >= function);
+    REQUIRE(references[0] < function + 16);
+
+    std::vector<uintptr_t> targets;
+    targets.push_back(entry + 1);
+    targets.push_back(entry);
+
+    std::vector<std::vector<uintptr_t>> batch = scanner.FindReferences(targets);
+    REQUIRE(batch.size() == 2);
+    REQUIRE(batch[0].empty());
+    REQUIRE(batch[1] == references);
+  }
+
+  SECTION("async", "It finds the 'Add' function asynchronously") {
+    const Signature signature(std::vector<byte>(
+      reinterpret_cast<byte*>(&Add),
+      reinterpret_cast<byte*>(&Add) + 10), "xxxxxxxxxx");
+
+    std::future<uintptr_t> result = scanner.FindSignatureAsync(signature);
+    REQUIRE(result.get() == reinterpret_cast<uintptr_t>(&Add));
+
+    // The executor runs the search immediately, after it has been cancelled
+    CancellationToken token;
+    token.Cancel();
+
+    std::future<std::vector<uintptr_t>> results = scanner.FindAllSignaturesAsync(
+      signature, token, [](std::function<void()> task) { task(); });
+    REQUIRE_THROWS_AS(results.get(), SignatureScanner::CancelledException);
+  }
+
+#ifdef SCANNER_COROUTINES
+  SECTION("generator", "It finds the matches of a signature lazily") {
+    const Signature signature(std::vector<byte>(
+      reinterpret_cast<byte*>(&Add),
+      reinterpret_cast<byte*>(&Add) + 2), "xx");
+
+    std::vector<uintptr_t> matches;
+    for(uintptr_t match : scanner.Matches(signature)) {
+      matches.push_back(match);
+    }
+
+    REQUIRE(matches == scanner.FindAllSignatures(signature));
+
+    // Only the first match is searched for
+    Generator<uintptr_t> generator = scanner.Matches(signature);
+    REQUIRE(*generator.begin() == matches.front());
+  }
+#endif
+
+  SECTION("statistics", "It counts the work of a search") {
+    const Signature signature(std::vector<byte>(
+      reinterpret_cast<byte*>(&Add),
+      reinterpret_cast<byte*>(&Add) + 10), "xxxxxxxxxx");
+
+    REQUIRE(Signature(signature.ToString()).ToString() == signature.ToString());
+    REQUIRE(Signature("4? C0&F8 ?").ToString() == "4? C0&F8 ?");
+
+    std::shared_ptr<ScanStatistics> statistics = std::make_shared<ScanStatistics>();
+    scanner.SetStatistics(statistics);
+    REQUIRE(scanner.FindSignature(signature) == reinterpret_cast<uintptr_t>(&Add));
+
+    const ScanStatistics::Counters counters = statistics->GetCounters();
+    REQUIRE(counters.bytesScanned > 0);
+    REQUIRE(counters.regionsVisited > 0);
+    REQUIRE(counters.candidates >= counters.matches);
+    REQUIRE(counters.verifications >= counters.matches);
+    REQUIRE(counters.matches == 1);
+    REQUIRE(ScanStatistics::GetLastScan().bytesScanned == counters.bytesScanned);
+    REQUIRE(statistics->GetLatencies()[signature.ToString()].count == 1);
+    REQUIRE(statistics->ToJson().find("\"matches\":1,") != std::string::npos);
+
+    // The signatures of a batch are charged their own work, rather than the
+    // duration of the whole batch (the absent one is searched for longest).
+    std::vector<Signature> signatures;
+    signatures.push_back(signature);
+    signatures.push_back(Signature("DE AD BE EF 13 37 C0 DE"));
+
+    statistics->Reset();
+    const auto started = std::chrono::steady_clock::now();
+    REQUIRE(scanner.FindSignatures(signatures)[0] == reinterpret_cast<uintptr_t>(&Add));
+    const uint64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - started).count();
+
+    std::map<std::string, ScanStatistics::Latency> latencies = statistics->GetLatencies();
+    const uint64_t found = latencies[signatures[0].ToString()].totalNanoseconds;
+    const uint64_t absent = latencies[signatures[1].ToString()].totalNanoseconds;
+
+    REQUIRE(latencies[signatures[0].ToString()].count == 1);
+    REQUIRE(latencies[signatures[1].ToString()].count == 1);
+    REQUIRE(found != absent);
+    REQUIRE(elapsed >= found + absent);
+  }
+
+  SECTION("trace", "It records the phases of a search") {
+    const Signature signature(std::vector<byte>(
+      reinterpret_cast<byte*>(&Add),
+      reinterpret_cast<byte*>(&Add) + 10), "xxxxxxxxxx");
+
+    Tracer::Enable();
+    Tracer::Clear();
+    REQUIRE(scanner.FindSignature(signature) == reinterpret_cast<uintptr_t>(&Add));
+    Tracer::Disable();
+
+    std::ostringstream trace;
+    Tracer::WriteChromeTrace(trace);
+    REQUIRE(trace.str().find("\"name\":\"search\"") != std::string::npos);
+    REQUIRE(trace.str().find("\"name\":\"region\"") != std::string::npos);
+
+    // Candidate verifications are recorded in bursts
+    Tracer::Enable();
+    Tracer::Clear();
+    REQUIRE(scanner.FindSignature(signature, 0, SignatureScanner::npos,
+      SignatureScanner::FunctionStarts) == reinterpret_cast<uintptr_t>(&Add));
+    Tracer::Disable();
+
+    trace.str("");
+    Tracer::WriteChromeTrace(trace);
+    REQUIRE(trace.str().find("\"name\":\"verification\"") != std::string::npos);
+
+    // The buffers of exited threads are reused once their events are written
+    auto record = []() {
+      std::thread thread([]() { Tracer::Scope scope("thread"); });
+      thread.join();
+
+      std::ostringstream stream;
+      Tracer::WriteChromeTrace(stream);
+      return stream.str();
+    };
+
+    Tracer::Enable();
+    REQUIRE(record().find("\"name\":\"thread\"") != std::string::npos);
+    const size_t buffers = Tracer::GetBufferCount();
+
+    for(int i = 0; i < 4; i++) {
+      REQUIRE(record().find("\"name\":\"thread\"") != std::string::npos);
+      REQUIRE(Tracer::GetBufferCount() == buffers);
+    }
+
+    Tracer::Disable();
+  }
+
+  SECTION("selectivity", "It profiles the selectivity of signatures") {
+    std::vector<byte> values(
+      reinterpret_cast<byte*>(&Add),
+      reinterpret_cast<byte*>(&Add) + 10);
+
+    std::vector<Signature> signatures;
+    signatures.push_back(Signature(values, "xxxxxxxxx?"));
+    signatures.push_back(Signature(values, "xxxxxxxxxx"));
+
+    std::vector<SelectivityReport> reports = scanner.ProfileSignatures(signatures);
+    REQUIRE(reports.size() == 2);
+    REQUIRE(reports[1].matches == 1);
+    REQUIRE(reports[1].anchorHits >= 1);
+    REQUIRE(reports[1].failures.size() == values.size());
+    REQUIRE(reports[1].signature == signatures[1].ToString());
+
+    // A single match is not enough to suggest a tightening
+    REQUIRE(reports[0].matches == 1);
+    REQUIRE(reports[0].tightenings.empty());
+    REQUIRE((reports[0].timeShare + reports[1].timeShare) > 0.99);
+    REQUIRE(!reports[0].ToString().empty());
+
+    // Both records match; the wildcard within the tag is equal in either,
+    // but the function pointers are relocated, so they are not suggested.
+    // The search starts at the records, since the file contents of a small
+    // library may be mapped more than once (i.e unrelocated).
+    const Twin* twins = GetTwins();
+    const size_t offset = reinterpret_cast<uintptr_t>(twins) -
+      reinterpret_cast<uintptr_t>(scanner.GetBaseAddress());
+    std::vector<byte> twin(
+      reinterpret_cast<const byte*>(&twins[0]),
+      reinterpret_cast<const byte*>(&twins[0]) + sizeof(Twin));
+    std::string mask(offsetof(Twin, function), 'x');
+    mask[2] = '?';
+    mask.append(sizeof(Twin) - offsetof(Twin, function), '?');
+
+    reports = scanner.ProfileSignatures(
+      std::vector<Signature>(1, Signature(twin, mask.c_str())), offset);
+    REQUIRE(reports[0].matches == 2);
+    REQUIRE(reports[0].tightenings.size() == 1);
+    REQUIRE(reports[0].tightenings[0] == std::make_pair(size_t(2), twin[2]));
+  }
+
+  SECTION("wildcards", "It finds the 'Add' function using mostly wildcards") {
+    std::vector<byte> signature(
+      reinterpret_cast<byte*>(&Add),
+      reinterpret_cast<byte*>(&Add) + 12);
+
+    // Without a selective anchor the bit-parallel search is used
+    const Signature sparse(signature, "x?x?x?x?x?x?");
+    const uintptr_t first = scanner.FindSignature(sparse);
+    REQUIRE(first != 0);
+    REQUIRE(first <= reinterpret_cast<uintptr_t>(&Add));
+    REQUIRE(sparse.Matches(reinterpret_cast<const byte*>(first)));
+
+    std::vector<uintptr_t> matches = scanner.FindAllSignatures(sparse);
+    REQUIRE(std::find(matches.begin(), matches.end(),
+      reinterpret_cast<uintptr_t>(&Add)) != matches.end());
+  }
+
+  SECTION("boundary", "It matches signatures ending at an unreadable page") {
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    byte* pages = static_cast<byte*>(mmap(nullptr, pageSize * 2,
+      PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+    REQUIRE(pages != MAP_FAILED);
+    REQUIRE(mprotect(pages + pageSize, pageSize, PROT_NONE) == 0);
+
+    for(size_t size = 1; size <= 80; size++) {
+      byte* data = pages + pageSize - size;
+      for(size_t i = 0; i < size; i++) {
+        data[i] = static_cast<byte>(i * 7 + 1);
+      }
+
+      std::vector<byte> values(data, data + size);
+      std::string mask(size, 'x');
+      if(size > 2) {
+        mask[size / 2] = '?';
+      }
+
+      REQUIRE(Signature(values, mask.c_str()).Matches(data));
+      values[size - 1] ^= 0xFF;
+      REQUIRE(!Signature(values, mask.c_str()).Matches(data));
+    }
+
+    munmap(pages, pageSize * 2);
+  }
+
+  SECTION("alignment", "It finds the 'Add' function at aligned addresses") {
+    const uintptr_t function = reinterpret_cast<uintptr_t>(&Add);
+    const byte* code = reinterpret_cast<const byte*>(&Add);
+
+    Signature signature(std::vector<byte>(code, code + 8), "xxxxxxxx");
+    signature.SetAlignment(16, function % 16);
+    REQUIRE(scanner.FindSignature(signature) == function);
+    REQUIRE(scanner.FindSignature(signature, 0, SignatureScanner::npos,
+      SignatureScanner::IgnoreRelocations) == function);
+
+    signature.SetAlignment(16, (function + 1) % 16);
+    REQUIRE(scanner.FindSignature(signature) != function);
+    REQUIRE_THROWS_AS(signature.SetAlignment(16, 16), Signature::Exception);
+  }
+
+  SECTION("functions", "It finds the 'Add' function at function starts") {
+    const uintptr_t function = reinterpret_cast<uintptr_t>(&Add);
+    const byte* code = reinterpret_cast<const byte*>(&Add);
+
+    const FunctionIndex::Function* entry = scanner.GetFunctionIndex().Find(function + 1);
+    REQUIRE(entry != nullptr);
+    REQUIRE(entry->address == function);
+    REQUIRE(entry->size > 1);
+
+    const Signature start(std::vector<byte>(code, code + entry->size),
+      std::vector<byte>(entry->size, 0xFF));
+    REQUIRE(scanner.FindSignature(start, 0, SignatureScanner::npos,
+      SignatureScanner::FunctionStarts) == function);
+    REQUIRE(scanner.FindSignatureInFunction(start, function + 2) == function);
+
+    const Signature body(std::vector<byte>(code + 1, code + entry->size),
+      std::vector<byte>(entry->size - 1, 0xFF));
+    REQUIRE(scanner.FindSignatureInFunction(body, function) == function + 1);
+    REQUIRE(scanner.FindAllSignatures(body, 0, SignatureScanner::npos,
+      SignatureScanner::FunctionStarts).empty());
+  }
+
+  SECTION("fingerprints", "It finds the 'Add' function by its fingerprint") {
+    const uintptr_t function = reinterpret_cast<uintptr_t>(&Add);
+    const size_t offset = function - reinterpret_cast<uintptr_t>(scanner.GetBaseAddress());
+    const std::string buildId = scanner.GetBuildId();
+    REQUIRE(!buildId.empty());
+
+    const FingerprintIndex& index = scanner.GetFingerprintIndex("/tmp");
+    REQUIRE(index.GetBuildId() == buildId);
+
+    const FingerprintIndex::Function* entry = nullptr;
+    for(const FingerprintIndex::Function& candidate : index.GetFunctions()) {
+      if(candidate.offset == offset) {
+        entry = &candidate;
+      }
+    }
+
+    REQUIRE(entry != nullptr);
+    std::vector<const FingerprintIndex::Function*> matches = index.FindAll(entry->fingerprint);
+    REQUIRE(std::find(matches.begin(), matches.end(), entry) != matches.end());
+    REQUIRE(scanner.FindFunction(entry->fingerprint) != 0);
+    REQUIRE(index.FindChanged(index).empty());
+
+    // Another scanner of the module reads the persisted index
+    SignatureScanner other(reinterpret_cast<void*>(&Add));
+    const FingerprintIndex& persisted = other.GetFingerprintIndex("/tmp");
+    REQUIRE(persisted.GetFunctions().size() == index.GetFunctions().size());
+    REQUIRE(persisted.FindChanged(index).empty());
+    REQUIRE(std::remove(("/tmp/" + buildId + ".fingerprints").c_str()) == 0);
+  }
+
+  SECTION("policies", "It finds the 'Add' function with a policy-based scanner") {
+    const uintptr_t function = reinterpret_cast<uintptr_t>(&Add);
+    const byte* code = reinterpret_cast<const byte*>(&Add);
+    Signature signature(std::vector<byte>(code, code + 10), "xx?xxxxxxx");
+
+    BasicScanner<> module((ModuleSource(scanner)));
+    REQUIRE(module.FindSignature(signature) == scanner.FindSignature(signature));
+    REQUIRE(module.FindAllSignatures(signature) == scanner.FindAllSignatures(signature));
+
+    // A copy of the function is searched in place, with a custom sink
+    std::vector<byte> buffer(64, 0xCC);
+    std::copy(code, code + 10, buffer.begin() + 20);
+    std::copy(code, code + 10, buffer.begin() + 40);
+
+    BasicScanner<MemorySource, SignatureEngine, MatchListSink> memory(
+      MemorySource(buffer.data(), buffer.size()));
+    MatchListSink sink;
+    memory.Scan(signature, sink);
+
+    REQUIRE(sink.GetMatches().size() == 2);
+    REQUIRE(sink.GetMatches()[0] == buffer.data() + 20);
+    REQUIRE(sink.GetMatches()[1] == buffer.data() + 40);
+    REQUIRE(memory.FindSignature(signature) == reinterpret_cast<uintptr_t>(buffer.data() + 20));
+    REQUIRE(module.FindSignature(signature) == function);
+
+    // The default instantiation searches like the scanner does
+    const size_t offset = function - reinterpret_cast<uintptr_t>(scanner.GetBaseAddress());
+    REQUIRE(BasicScanner<>(ModuleSource(scanner, offset)).FindSignature(signature) == function);
+    REQUIRE(BasicScanner<>(ModuleSource(scanner, offset + 1)).FindSignature(signature) ==
+      scanner.FindSignature(signature, offset + 1));
+    REQUIRE_THROWS_AS(ModuleSource(scanner, 0, SignatureScanner::npos,
+      SignatureScanner::FunctionStarts), SignatureScanner::Exception);
+
+    const ByteProfile& profile = scanner.GetByteProfile();
+    REQUIRE(ModuleSource(scanner).GetProfile() == &profile);
+    REQUIRE(MemorySource(buffer.data(), buffer.size()).GetProfile() == nullptr);
+
+    const Entry* addEntry = GetEntry();
+    std::vector<byte> entry(sizeof(Entry), 0xCC);
+    memcpy(&entry[0], &addEntry->head, sizeof(addEntry->head));
+    memcpy(&entry[offsetof(Entry, tail)], &addEntry->tail, sizeof(addEntry->tail));
+    const Signature relocated(entry, std::string(entry.size(), 'x').c_str());
+
+    REQUIRE(module.FindSignature(relocated) == 0);
+    REQUIRE(BasicScanner<>(ModuleSource(scanner, 0, SignatureScanner::npos,
+      SignatureScanner::IgnoreRelocations)).FindSignature(relocated) ==
+      reinterpret_cast<uintptr_t>(addEntry));
+
+    // Matches are resolved within the source
+    Resolver resolver;
+    resolver.Offset(offsetof(Entry, function)).Dereference();
+
+    const Signature head(std::vector<byte>(entry.begin(), entry.begin() + sizeof(addEntry->head)),
+      std::string(sizeof(addEntry->head), 'x').c_str());
+    REQUIRE(module.FindSignature(head, resolver) == scanner.FindSignature(head, resolver));
+    REQUIRE(module.FindSignature(head, resolver) == function);
+    REQUIRE(module.FindAllSignatures(head, resolver) == scanner.FindAllSignatures(head, resolver));
+
+    // Reads outside of a memory block cannot be resolved
+    uintptr_t filler;
+    memcpy(&filler, buffer.data(), sizeof(filler));
+    REQUIRE(memory.FindSignature(signature, Resolver().Offset(-20).Dereference()) == filler);
+    REQUIRE(memory.FindSignature(signature, Resolver().Offset(60).Dereference()) == 0);
+  }
+
+  SECTION("packs", "It finds the 'Add' function using a signature pack") {
+    const uintptr_t function = reinterpret_cast<uintptr_t>(&Add);
+    const byte* code = reinterpret_cast<const byte*>(&Add);
+
+    Signature aligned(std::vector<byte>(code, code + 8), "xxxxxxxx");
+    aligned.SetAlignment(16, function % 16);
+
+    std::vector<std::string> names = { "Add", "AlignedAdd" };
+    std::vector<Signature> signatures = {
+      Signature(std::vector<byte>(code, code + 10), "xx?xxxxxxx"),
+      aligned,
+    };
+    std::vector<Resolver> resolvers = { Resolver().Offset(-4).Offset(4), Resolver() };
+
+    std::ostringstream stream;
+    REQUIRE(SignaturePack::Save(stream, names, signatures, resolvers));
+    const std::string data = stream.str();
+
+    SignaturePack pack(data.data(), data.size());
+    REQUIRE(pack.GetCount() == 2);
+    REQUIRE(pack.Find("AlignedAdd") == 1);
+    REQUIRE(pack.Find("Sub") == SignaturePack::npos);
+    REQUIRE(std::string(pack.GetName(0)) == "Add");
+    REQUIRE(pack.GetSignature(0).ToString() == signatures[0].ToString());
+    REQUIRE(pack.GetSignature(1).GetAlignment() == 16);
+    REQUIRE(pack.GetResolver(0).GetSteps().size() == 2);
+    REQUIRE(scanner.FindSignature(pack.GetValues(0), pack.GetMasks(0), pack.GetSize(0)) == function);
+    REQUIRE(scanner.FindSignatures(pack.GetSignatures(), pack.GetResolvers()) ==
+      std::vector<uintptr_t>({ function, function }));
+
+    // The file is mapped and validated before use; its checksum on demand
+    const char* path = "/tmp/scanner-tester.pack";
+    std::ofstream(path, std::ios::binary) << data;
+    REQUIRE(SignaturePack(path).GetSignature(1).ToString() == signatures[1].ToString());
+    REQUIRE(pack.Verify());
+
+    std::string corrupt = data;
+    corrupt[corrupt.size() - 1] ^= 0xFF;
+    REQUIRE(!SignaturePack(corrupt.data(), corrupt.size()).Verify());
+    corrupt = data;
+    corrupt[16] = 0x7F;
+    REQUIRE_THROWS_AS(SignaturePack(corrupt.data(), corrupt.size()), SignaturePack::Exception);
+    corrupt = data;
+    corrupt[4] = 2;
+    REQUIRE_THROWS_AS(SignaturePack(corrupt.data(), corrupt.size()), SignaturePack::Exception);
+    REQUIRE_THROWS_AS(SignaturePack(data.data(), 16), SignaturePack::Exception);
+    REQUIRE(std::remove(path) == 0);
+  }
+
+  SECTION("cache", "It finds the 'Add' function through a shared result cache") {
+    const uintptr_t function = reinterpret_cast<uintptr_t>(&Add);
+    const byte* code = reinterpret_cast<const byte*>(&Add);
+    const Signature signature(std::vector<byte>(code, code + 10), "xx?xxxxxxx");
+    const Signature missing("CC CC CC CC CC CC CC CC CC CC CC CC CC CC CC CC F4 F4");
+    const std::string name = "scanner-tester-" + std::to_string(getpid());
+
+    std::shared_ptr<ResultCache> cache = std::make_shared<ResultCache>(name, 100);
+    REQUIRE(cache->GetCapacity() == 128);
+
+    SignatureScanner first(reinterpret_cast<void*>(&Add));
+    first.SetResultCache(cache);
+    REQUIRE(first.FindSignature(signature) == function);
+    REQUIRE(first.FindSignature(missing) == 0);
+    REQUIRE(first.FindSignature(signature, Resolver().Offset(1)) == function + 1);
+
+    // Another mapping of the segment (e.g in another process) is served
+    // without a search; only searches are counted by the statistics.
+    std::shared_ptr<ScanStatistics> statistics = std::make_shared<ScanStatistics>();
+    SignatureScanner second(reinterpret_cast<void*>(&Add));
+    second.SetResultCache(std::make_shared<ResultCache>(name));
+    second.SetStatistics(statistics);
+
+    REQUIRE(second.GetResultCache()->GetCapacity() == 128);
+    REQUIRE(second.FindSignature(signature) == function);
+    REQUIRE(second.FindSignature(missing) == 0);
+    REQUIRE(second.FindSignature(signature, Resolver().Offset(1)) == function + 1);
+    REQUIRE(statistics->GetCounters().regionsVisited == 0);
+    REQUIRE(second.FindSignature(signature, Resolver().Offset(2)) == function + 2);
+    REQUIRE(statistics->GetCounters().regionsVisited > 0);
+
+    // Dereferenced pointers are read on every search, even when null at first
+    const byte* accessor = reinterpret_cast<const byte*>(&GetLocalPlayer);
+    const Signature global(std::vector<byte>(accessor, accessor + 8), "xxxxxxxx");
+    const Resolver player = Resolver().Relative32(3, 7).Dereference();
+    const uintptr_t greeting = reinterpret_cast<uintptr_t>(GetGreeting());
+
+    REQUIRE(first.FindSignature(global) == reinterpret_cast<uintptr_t>(accessor));
+    REQUIRE(first.FindSignature(global, player) == 0);
+    SetLocalPlayer(GetGreeting());
+    REQUIRE(first.FindSignature(global, player) == greeting);
+    SetLocalPlayer(reinterpret_cast<const void*>(&Add));
+    REQUIRE(second.FindSignature(global, player) == function);
+    SetLocalPlayer(nullptr);
+
+    size_t offset;
+    REQUIRE(cache->Insert(1, 42));
+    REQUIRE(cache->Find(1, &offset));
+    REQUIRE(offset == 42);
+    REQUIRE(!cache->Find(2, &offset));
+    REQUIRE(ResultCache::Remove(name));
+
+    // A segment abandoned before being sized is replaced by a new cache
+    const int abandoned = shm_open(('/' + name).c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    REQUIRE(abandoned >= 0);
+    close(abandoned);
+    REQUIRE(ResultCache(name, 16).GetCapacity() == 16);
+    REQUIRE(ResultCache::Remove(name));
+  }
+
+  SECTION("batch", "It finds many signatures in a single pass") {
+    const byte* code = reinterpret_cast<const byte*>(&Add);
+    const byte* greeting = reinterpret_cast<const byte*>(GetGreeting());
+
+    std::vector<Signature> signatures;
+    signatures.push_back(Signature(std::vector<byte>(code, code + 8), "xxxxxxxx"));
+    signatures.push_back(Signature(std::vector<byte>(code, code + 6), "xx?xxx"));
+    signatures.push_back(Signature(std::vector<byte>(greeting, greeting + 9), "xxxxxxxxx"));
+    signatures.push_back(Signature(std::vector<byte>(greeting + 4, greeting + 12), "xxx?xxxx"));
+    signatures.push_back(Signature("DE AD BE EF DE AD BE EF"));
+
+    std::vector<uintptr_t> results = scanner.FindSignatures(signatures);
+    REQUIRE(results.size() == signatures.size());
+
+    for(size_t i = 0; i < signatures.size(); i++) {
+      REQUIRE(results[i] == scanner.FindSignature(signatures[i]));
+    }
+  }
+
+  SECTION("pointers", "It finds the pointer to the 'Add' function") {
+    const uintptr_t function = reinterpret_cast<uintptr_t>(&Add);
+    const uintptr_t slot = reinterpret_cast<uintptr_t>(&GetEntry()->function);
+
+    std::vector<uintptr_t> pointers = scanner.FindPointers(function, function + 1);
+    REQUIRE(std::find(pointers.begin(), pointers.end(), slot) != pointers.end());
+    REQUIRE(scanner.FindPointers(function, function).empty());
+
+    pointers = scanner.FindPointers(function, function + 1, 0,
+      SignatureScanner::npos, SignatureScanner::ExecutableRegion);
+    REQUIRE(std::find(pointers.begin(), pointers.end(), slot) == pointers.end());
+
+    // A heap block lies outside the module, so it has to be supplied
+    std::unique_ptr<uintptr_t[]> block(new uintptr_t[4]());
+    block[2] = function;
+
+    const uintptr_t heap = reinterpret_cast<uintptr_t>(block.get());
+    const uintptr_t heapSlot = reinterpret_cast<uintptr_t>(&block[2]);
+
+    pointers = scanner.FindPointers(function, function + 1);
+    REQUIRE(std::find(pointers.begin(), pointers.end(), heapSlot) == pointers.end());
+
+    SignatureScanner::RegionList ranges(1, std::make_pair(heap, heap + 4 * sizeof(uintptr_t)));
+    pointers = scanner.FindPointers(function, function + 1, ranges);
+    REQUIRE(pointers.size() == 1);
+    REQUIRE(pointers[0] == heapSlot);
+
+    pointers = scanner.FindPointers(function, function + 1, ranges,
+      SignatureScanner::ExecutableRegion);
+    REQUIRE(pointers.empty());
+  }
+
+  SECTION("strings", "It finds the code referring to a string") {
+    const uintptr_t greeting = reinterpret_cast<uintptr_t>(GetGreeting());
+    const uintptr_t function = reinterpret_cast<uintptr_t>(&GetGreeting);
+
+    REQUIRE(scanner.FindString("Greetings from the signature scanner") == greeting);
+    REQUIRE(scanner.FindString("from the signature scanner") == greeting + 10);
+    REQUIRE(scanner.FindString("Greetings from the") == 0);
+    REQUIRE(scanner.FindString("Greetings", SignatureScanner::Utf16String) == 0);
+
+    std::vector<uintptr_t> references =
+      scanner.FindStringReferences("Greetings from the signature scanner");
+    REQUIRE(references.size() == 1);
+    REQUIRE(references[0] >= function);
+    REQUIRE(references[0] < function + 16);
+  }
+
+  SECTION("vtables", "It finds the virtual table of a class") {
+    Shape* square = CreateSquare(3);
+    const uintptr_t vtable = *reinterpret_cast<const uintptr_t*>(square);
+
+    REQUIRE(square->GetArea() == 9);
+    REQUIRE(scanner.FindVtable("(anonymous namespace)::Square") == 0);
+    REQUIRE(scanner.FindVtable("N12_GLOBAL__N_16SquareE") == vtable);
+    REQUIRE(scanner.FindVtable("Circle") == 0);
+
+    const VtableIndex::Vtable* entry =
+      scanner.GetVtableIndex().Find("N12_GLOBAL__N_16SquareE");
+    REQUIRE(entry != nullptr);
+    REQUIRE(entry->offsetToTop == 0);
+    REQUIRE(entry->functionCount == 3);
+    delete square;
   }
 }
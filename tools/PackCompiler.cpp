@@ -0,0 +1,169 @@
+/* Signature pack compiler
+ *
+ * Compiles a text file of named signatures into a signature pack (see
+ * <SignaturePack>). Each line that is neither empty nor a comment ('#')
+ * describes a signature:
+ *
+ *   <name> = <pattern> [; <directive>]...
+ *
+ * The pattern uses the syntax of <Signature>. The directives are applied in
+ * order; 'align' sets the alignment of the signature, and the remaining
+ * ones append a step to its resolver:
+ *
+ *   align <alignment> [<remainder>]
+ *   offset <offset>
+ *   rel8 <operand> <length>
+ *   rel32 <operand> <length>
+ *   deref
+ *
+ * Numbers are decimal, or hexadecimal with a '0x' prefix. For example:
+ *
+ *   # mov rax, [rip + rel32] followed by a null check
+ *   LocalPlayer = 48 8B 05 ? ? ? ? 48 85 C0 ; rel32 3 7 ; deref
+ *
+ * Usage: packc <input> <output>
+ */
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "SignaturePack.hpp"
+
+namespace {
+/* Remove leading and trailing whitespace */
+std::string Trim(const std::string& text) {
+  const size_t begin = text.find_first_not_of(" \t\r\n");
+  const size_t end = text.find_last_not_of(" \t\r\n");
+
+  return begin == std::string::npos ? std::string() : text.substr(begin, end - begin + 1);
+}
+
+/* Parse a number, throwing an exception if it is malformed */
+long long ParseNumber(std::istream& stream) {
+  std::string token;
+  if(!(stream >> token)) {
+    throw std::invalid_argument("missing number");
+  }
+
+  size_t length = 0;
+  long long value = 0;
+
+  try {
+    value = std::stoll(token, &length, 0);
+  } catch(const std::logic_error&) {
+  }
+
+  if(length == 0 || length != token.size()) {
+    throw std::invalid_argument("malformed number '" + token + "'");
+  }
+
+  return value;
+}
+
+/* Apply a directive to a signature and its resolver */
+void ApplyDirective(const std::string& directive, Signature* signature, Resolver* resolver) {
+  std::istringstream stream(directive);
+  std::string name;
+  stream >> name;
+
+  if(name == "align") {
+    const long long alignment = ParseNumber(stream);
+    const long long remainder = stream.eof() ? 0 : ParseNumber(stream);
+    signature->SetAlignment(static_cast<size_t>(alignment), static_cast<size_t>(remainder));
+  } else if(name == "offset") {
+    resolver->Offset(static_cast<ptrdiff_t>(ParseNumber(stream)));
+  } else if(name == "rel8" || name == "rel32") {
+    const long long operand = ParseNumber(stream);
+    const long long length = ParseNumber(stream);
+
+    if(operand < 0 || (operand + (name == "rel8" ? 1 : 4)) > length) {
+      throw std::invalid_argument("operand exceeds the instruction");
+    }
+
+    if(name == "rel8") {
+      resolver->Relative8(static_cast<size_t>(operand), static_cast<size_t>(length));
+    } else {
+      resolver->Relative32(static_cast<size_t>(operand), static_cast<size_t>(length));
+    }
+  } else if(name == "deref") {
+    resolver->Dereference();
+  } else {
+    throw std::invalid_argument("unknown directive '" + name + "'");
+  }
+
+  if(!stream.eof() && !(stream >> std::ws).eof()) {
+    throw std::invalid_argument("trailing input in directive '" + name + "'");
+  }
+}
+}
+
+int main(int argc, char* argv[]) {
+  if(argc != 3) {
+    std::cerr << "usage: " << argv[0] << " <input> <output>" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::ifstream input(argv[1]);
+  if(!input) {
+    std::cerr << argv[1] << ": couldn't open file" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::vector<std::string> names;
+  std::vector<Signature> signatures;
+  std::vector<Resolver> resolvers;
+
+  std::string line;
+  for(size_t number = 1; std::getline(input, line); number++) {
+    line = Trim(line);
+
+    if(line.empty() || line[0] == '#') {
+      continue;
+    }
+
+    try {
+      const size_t separator = line.find('=');
+      if(separator == std::string::npos) {
+        throw std::invalid_argument("expected '<name> = <pattern>'");
+      }
+
+      const std::string name = Trim(line.substr(0, separator));
+      std::istringstream parts(line.substr(separator + 1));
+      std::string part;
+
+      if(name.empty()) {
+        throw std::invalid_argument("missing signature name");
+      }
+
+      std::getline(parts, part, ';');
+      Signature signature(Trim(part));
+      Resolver resolver;
+
+      while(std::getline(parts, part, ';')) {
+        ApplyDirective(Trim(part), &signature, &resolver);
+      }
+
+      names.push_back(name);
+      signatures.push_back(signature);
+      resolvers.push_back(resolver);
+    } catch(const std::exception& error) {
+      std::cerr << argv[1] << ":" << number << ": " << error.what() << std::endl;
+      return EXIT_FAILURE;
+    }
+  }
+
+  std::ofstream output(argv[2], std::ios::binary | std::ios::trunc);
+  if(!output || !SignaturePack::Save(output, names, signatures, resolvers) || !output.flush()) {
+    std::cerr << argv[2] << ": couldn't write file" << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  std::cout << argv[2] << ": " << signatures.size() << " signatures" << std::endl;
+  return EXIT_SUCCESS;
+}
+
+/* vim: set ts=2 sw=2 expandtab: */